@@ -0,0 +1,377 @@
+/**
+ * Copyright (C) 2019 Regents of the University of California.
+ * @author: Peter Gusev <peter@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#include "base64.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace touch_ndn;
+
+// SIMD code paths are based on the vectorized base64 algorithms by Wojciech Muła and
+// Daniel Lemire (http://0x80.pl/articles/index.html#base64-algorithm-new,
+// https://github.com/lemire/fastbase64). Vector loops process whole blocks only and
+// report how much they've consumed; the rest (tails, padding, whitespace) is handled by
+// scalar code.
+
+namespace {
+    const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // maps characters to 6-bit values, -1 for characters outside of the alphabet
+    struct DecodeTable {
+        int8_t values_[256];
+        DecodeTable()
+        {
+            for (int i = 0; i < 256; ++i) values_[i] = -1;
+            for (int i = 0; i < 64; ++i) values_[(uint8_t)Alphabet[i]] = (int8_t)i;
+        }
+    };
+    const DecodeTable Decode;
+
+    // vector decoders store full registers, which may run past decoded bytes
+    const size_t DecodeSlack = 32;
+
+    // encodes len bytes, including padding; returns number of characters written
+    size_t encodeScalar(const uint8_t *in, size_t len, char *out)
+    {
+        char *o = out;
+        size_t i = 0;
+
+        for (; i + 2 < len; i += 3)
+        {
+            uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i+1] << 8 | in[i+2];
+            o[0] = Alphabet[(v >> 18) & 0x3f];
+            o[1] = Alphabet[(v >> 12) & 0x3f];
+            o[2] = Alphabet[(v >> 6) & 0x3f];
+            o[3] = Alphabet[v & 0x3f];
+            o += 4;
+        }
+
+        if (len - i == 1)
+        {
+            uint32_t v = (uint32_t)in[i] << 16;
+            o[0] = Alphabet[(v >> 18) & 0x3f];
+            o[1] = Alphabet[(v >> 12) & 0x3f];
+            o[2] = '=';
+            o[3] = '=';
+            o += 4;
+        }
+        else if (len - i == 2)
+        {
+            uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i+1] << 8;
+            o[0] = Alphabet[(v >> 18) & 0x3f];
+            o[1] = Alphabet[(v >> 12) & 0x3f];
+            o[2] = Alphabet[(v >> 6) & 0x3f];
+            o[3] = '=';
+            o += 4;
+        }
+
+        return o - out;
+    }
+
+    size_t encodeBlocksNone(const uint8_t*, size_t, char*) { return 0; }
+    size_t decodeBlocksNone(const uint8_t*, size_t, uint8_t*) { return 0; }
+
+#ifdef BASE64_X86
+    // -- SSSE3: 12 bytes -> 16 characters, 16 characters -> 12 bytes
+
+    __attribute__((target("ssse3")))
+    inline __m128i encReshuffle(__m128i in)
+    {
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        return _mm_or_si128(t1, t3);
+    }
+
+    __attribute__((target("ssse3")))
+    inline __m128i encTranslate(__m128i in)
+    {
+        const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                               '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                               '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+        __m128i idx = _mm_subs_epu8(in, _mm_set1_epi8(51));
+        const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+        idx = _mm_or_si128(idx, _mm_and_si128(less, _mm_set1_epi8(13)));
+        return _mm_add_epi8(_mm_shuffle_epi8(shiftLut, idx), in);
+    }
+
+    __attribute__((target("ssse3")))
+    size_t encodeBlocksSsse3(const uint8_t *in, size_t len, char *out)
+    {
+        size_t i = 0;
+        // loads 16 bytes, uses 12
+        for (; len - i >= 16; i += 12, out += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+            _mm_storeu_si128((__m128i*)out, encTranslate(encReshuffle(v)));
+        }
+        return i;
+    }
+
+    __attribute__((target("ssse3")))
+    size_t decodeBlocksSsse3(const uint8_t *in, size_t len, uint8_t *out)
+    {
+        const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                              0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i mask2F = _mm_set1_epi8(0x2f);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+
+        for (; len - i >= 16; i += 16, out += 12)
+        {
+            __m128i str = _mm_loadu_si128((const __m128i*)(in + i));
+            const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+            const __m128i loNibbles = _mm_and_si128(str, mask2F);
+            const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+            const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+
+            // any byte with (lo & hi) != 0 is not in the alphabet
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)) != 0xffff)
+                break;
+
+            const __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+            const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+            str = _mm_add_epi8(str, roll);
+
+            const __m128i mergeAbBc = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+            __m128i v = _mm_madd_epi16(mergeAbBc, _mm_set1_epi32(0x00011000));
+            v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            _mm_storeu_si128((__m128i*)out, v);
+        }
+        return i;
+    }
+
+    // -- AVX2: 24 bytes -> 32 characters, 32 characters -> 24 bytes
+
+    __attribute__((target("avx2")))
+    size_t encodeBlocksAvx2(const uint8_t *in, size_t len, char *out)
+    {
+        const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+        const __m256i shiftLut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                  '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                  '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                                  'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                  '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                  '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        size_t i = 0;
+
+        // two lanes of 12 bytes each; second 16-byte load must stay within input
+        for (; len - i >= 28; i += 24, out += 32)
+        {
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))),
+                                                _mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+            v = _mm256_shuffle_epi8(v, shuffle);
+            const __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+            const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+            const __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+            const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+            v = _mm256_or_si256(t1, t3);
+
+            __m256i idx = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+            const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), v);
+            idx = _mm256_or_si256(idx, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+            v = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, idx), v);
+
+            _mm256_storeu_si256((__m256i*)out, v);
+        }
+
+        return i + encodeBlocksSsse3(in + i, len - i, out);
+    }
+
+    __attribute__((target("avx2")))
+    size_t decodeBlocksAvx2(const uint8_t *in, size_t len, uint8_t *out)
+    {
+        const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                               0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                               0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                                 0, 0, 0, 0, 0, 0, 0, 0,
+                                                 0, 16, 19, 4, -65, -65, -71, -71,
+                                                 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i mask2F = _mm256_set1_epi8(0x2f);
+        const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+        size_t i = 0;
+
+        for (; len - i >= 32; i += 32, out += 24)
+        {
+            __m256i str = _mm256_loadu_si256((const __m256i*)(in + i));
+            const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+            const __m256i loNibbles = _mm256_and_si256(str, mask2F);
+            const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+            const __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+
+            if (!_mm256_testz_si256(lo, hi))
+                break;
+
+            const __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+            const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+            str = _mm256_add_epi8(str, roll);
+
+            const __m256i mergeAbBc = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+            __m256i v = _mm256_madd_epi16(mergeAbBc, _mm256_set1_epi32(0x00011000));
+            v = _mm256_shuffle_epi8(v, shuffle);
+            v = _mm256_permutevar8x32_epi32(v, permute);
+            _mm256_storeu_si256((__m256i*)out, v);
+        }
+
+        return i + decodeBlocksSsse3(in + i, len - i, out);
+    }
+#endif
+
+    typedef struct _Codec {
+        const char *name_;
+        // return number of input bytes/characters consumed
+        size_t (*encodeBlocks_)(const uint8_t*, size_t, char*);
+        size_t (*decodeBlocks_)(const uint8_t*, size_t, uint8_t*);
+        // smallest input decodeBlocks_ can process
+        size_t decodeBlockSize_;
+    } Codec;
+
+    Codec selectCodec()
+    {
+#ifdef BASE64_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return { "avx2", &encodeBlocksAvx2, &decodeBlocksAvx2, 16 };
+        if (__builtin_cpu_supports("ssse3"))
+            return { "ssse3", &encodeBlocksSsse3, &decodeBlocksSsse3, 16 };
+#endif
+        return { "scalar", &encodeBlocksNone, &decodeBlocksNone, 0 };
+    }
+
+    const Codec& getCodec()
+    {
+        static const Codec codec = selectCodec();
+        return codec;
+    }
+}
+
+const char*
+base64::getImplementation()
+{
+    return getCodec().name_;
+}
+
+void
+base64::encode(const uint8_t *data, size_t len, string &output)
+{
+    output.resize(getEncodedLength(len));
+    if (!len)
+        return;
+
+    char *out = &output[0];
+    size_t consumed = getCodec().encodeBlocks_(data, len, out);
+    encodeScalar(data + consumed, len - consumed, out + consumed / 3 * 4);
+}
+
+void
+base64::decode(const char *text, size_t len, vector<uint8_t> &output)
+{
+    const Codec &codec = getCodec();
+    const uint8_t *in = (const uint8_t*)text;
+
+    output.resize(len / 4 * 3 + 3 + DecodeSlack);
+    uint8_t *out = output.data(), *o = out;
+    uint32_t acc = 0;
+    int nAcc = 0;
+    size_t i = 0, vectorResume = 0;
+
+    while (i < len)
+    {
+        // vector loop stops at the first block with whitespace, padding or junk --
+        // get past that block with scalar code before trying again
+        if (codec.decodeBlockSize_ && nAcc == 0 && i >= vectorResume)
+        {
+            size_t consumed = codec.decodeBlocks_(in + i, len - i, o);
+            i += consumed;
+            o += consumed / 4 * 3;
+            vectorResume = i + codec.decodeBlockSize_;
+
+            if (i >= len)
+                break;
+        }
+
+        // whole quantum without whitespace
+        if (nAcc == 0 && len - i >= 4)
+        {
+            int8_t a = Decode.values_[in[i]], b = Decode.values_[in[i+1]];
+            int8_t c = Decode.values_[in[i+2]], d = Decode.values_[in[i+3]];
+            if ((a | b | c | d) >= 0)
+            {
+                uint32_t v = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | (uint32_t)d;
+                o[0] = (uint8_t)(v >> 16);
+                o[1] = (uint8_t)(v >> 8);
+                o[2] = (uint8_t)v;
+                o += 3;
+                i += 4;
+                continue;
+            }
+        }
+
+        uint8_t c = in[i++];
+        // skip whitespace, all of which is below the first base64 character '+'
+        if (c < '+')
+            continue;
+
+        int8_t v = Decode.values_[c];
+        if (v < 0)
+            break;
+
+        acc = (acc << 6) | (uint32_t)v;
+        if (++nAcc == 4)
+        {
+            o[0] = (uint8_t)(acc >> 16);
+            o[1] = (uint8_t)(acc >> 8);
+            o[2] = (uint8_t)acc;
+            o += 3;
+            acc = 0;
+            nAcc = 0;
+        }
+    }
+
+    if (nAcc == 2)
+        *o++ = (uint8_t)(acc >> 4);
+    else if (nAcc == 3)
+    {
+        *o++ = (uint8_t)(acc >> 10);
+        *o++ = (uint8_t)(acc >> 2);
+    }
+
+    output.resize(o - out);
+}
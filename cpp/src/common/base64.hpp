@@ -0,0 +1,54 @@
+/**
+ * Copyright (C) 2019 Regents of the University of California.
+ * @author: Peter Gusev <peter@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef base64_hpp
+#define base64_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace touch_ndn {
+
+    /**
+     * Standard (RFC 4648, padded) base64 codec.
+     * Uses AVX2 or SSSE3 code paths when the CPU supports them (checked once at runtime)
+     * and falls back to scalar code otherwise. Output is written into caller-provided
+     * containers, so callers that keep them around avoid reallocating on every call.
+     */
+    namespace base64 {
+        // Returns the name of the code path in use ("avx2", "ssse3" or "scalar").
+        const char* getImplementation();
+
+        // Returns length of the encoded string (incl. padding) for len input bytes.
+        inline size_t getEncodedLength(size_t len) { return ((len + 2) / 3) * 4; }
+
+        // Encodes len bytes into output, replacing its contents.
+        void encode(const uint8_t* data, size_t len, std::string& output);
+
+        // Decodes base64 text into output, replacing its contents. Characters below '+'
+        // (whitespace, line breaks) are skipped. Decoding stops at padding or at the first
+        // character outside of the base64 alphabet.
+        void decode(const char* text, size_t len, std::vector<uint8_t>& output);
+    }
+}
+
+#endif /* base64_hpp */
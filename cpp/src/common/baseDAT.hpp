@@ -42,6 +42,8 @@ namespace touch_ndn {
                                     void* reserved1) override;
         
         static std::string toBase64(const ndn::Blob&);
+        // encodes into provided string, reusing its storage
+        static void toBase64(const ndn::Blob&, std::string&);
         static void fromBase64(const std::string&, std::vector<uint8_t>&);
     protected:
         
@@ -129,11 +129,12 @@ namespace touch_ndn
     bool
     OP_Common::opPathChanged(std::string path, std::string& oldFullPath)
     {
-        if ((opPath_ + opName_) != std::string(path))
+        if (fullPath_ != path)
         {
-            oldFullPath = opPath_ + opName_;
+            oldFullPath = fullPath_;
             std::string oldName = opName_, oldPath = opPath_;
             extractOpName(path, opPath_, opName_);
+            fullPath_ = opPath_ + opName_;
             
             opPathUpdated(oldFullPath, oldPath, oldName);
             
@@ -33,6 +33,8 @@
 #define PAR_PAGE_DEFAULT "Custom"
 #define PAR_INIT "Init"
 #define PAR_INIT_LABEL "Init"
+#define PAR_DUMP_MEMORY "Dumpmemory"
+#define PAR_DUMP_MEMORY_LABEL "Dump Memory Usage"
 
 #define OP_EVENT_DESTROY "destroy"
 #define OP_EVENT_RESET "reset"
@@ -46,7 +48,17 @@
 #define OPLOG_ERROR(...) OPLOG_HELPER(ERROR, __VA_ARGS__)
 #define OPLOG_CRITICAL(...) OPLOG_HELPER(CRITICAL, __VA_ARGS__)
 
-#define OPLOG_HELPER(LEVEL, ...) TLOG_LOGGER_##LEVEL(logger_,("["+getFullPath() +"] " + FIRST(__VA_ARGS__)).c_str() REST(__VA_ARGS__) )
+// level is checked before any string work; with TOUCHNDN_LOG_MODE=ring, messages
+// are stored as binary records and formatted on the log thread
+#define OPLOG_HELPER(LEVEL, ...) do { \
+    if (logger_ && logger_->should_log(TLOG_LEVEL_##LEVEL)) { \
+        if (touch_ndn::isRingLogEnabled()) \
+            touch_ndn::ringLog(logger_.get(), TLOG_LEVEL_##LEVEL, __FILE__, __LINE__, \
+                               static_cast<const char*>(__FUNCTION__), \
+                               getFullPath().data(), getFullPath().size(), __VA_ARGS__); \
+        else \
+            TLOG_LOGGER_##LEVEL(logger_,("["+getFullPath() +"] " + FIRST(__VA_ARGS__)).c_str() REST(__VA_ARGS__) ); \
+    } } while(0)
 
 // https://stackoverflow.com/a/11172679/846340
 #define FIRST(...) FIRST_HELPER(__VA_ARGS__, throwaway)
@@ -88,12 +100,12 @@ namespace touch_ndn {
         // in either way, path is checked for existing ".." and updated accordingly
         std::string getCanonical(const std::string &path) const;
         bool getIsReady() const { return isReady_; }
-        std::string getFullPath() const { return opPath_ + opName_; }
+        const std::string& getFullPath() const { return fullPath_; }
         
     protected:
         std::shared_ptr<spdlog::logger> logger_;
         std::vector<OP_Common*> listeners_;
-        std::string opName_, opPath_;
+        std::string opName_, opPath_, fullPath_;
         std::string errorString_, warningString_, infoString_;
         std::map<std::string, void*> pairedOps_;
         bool isReady_;
@@ -139,6 +151,7 @@ namespace touch_ndn {
         , executeCount_(0)
         {
             extractOpName(info->opPath, opPath_, opName_);
+            fullPath_ = opPath_ + opName_;
             saveOp(opPath_+opName_, this);
         }
         
@@ -168,7 +181,7 @@ namespace touch_ndn {
         virtual int32_t
         getNumInfoCHOPChans(void *reserved1) override
         {
-            return 2;
+            return 3 + (int32_t)memoryCounters_.size();
         }
         
         virtual void
@@ -185,7 +198,23 @@ namespace touch_ndn {
                     chan->name->setString("executeQueue");
                     chan->value = (float)executeQueue_.size();
                 } break;
-                default: break;
+                case 2: {
+                    int64_t total = 0;
+                    for (auto &c:memoryCounters_)
+                        total += c.second->load();
+                    chan->name->setString("memoryBytes");
+                    chan->value = (float)total;
+                } break;
+                default: {
+                    size_t idx = index - 3;
+                    if (idx < memoryCounters_.size())
+                    {
+                        std::string category = memoryCounters_[idx].first;
+                        category[0] = toupper(category[0]);
+                        chan->name->setString(("memory"+category+"Bytes").c_str());
+                        chan->value = (float)memoryCounters_[idx].second->load();
+                    }
+                } break;
             }
         }
         
@@ -233,6 +262,15 @@ namespace touch_ndn {
                 np.label = PAR_INIT_LABEL;
                 np.page = PAR_PAGE_DEFAULT;
                 
+                OP_ParAppendResult res = manager->appendPulse(np);
+                assert(res == OP_ParAppendResult::Success);
+            }
+            {
+                OP_NumericParameter np(PAR_DUMP_MEMORY);
+                
+                np.label = PAR_DUMP_MEMORY_LABEL;
+                np.page = PAR_PAGE_DEFAULT;
+                
                 OP_ParAppendResult res = manager->appendPulse(np);
                 assert(res == OP_ParAppendResult::Success);
             }
@@ -244,6 +282,10 @@ namespace touch_ndn {
             {
                 initPulsed();
             }
+            if (strcmp(name, PAR_DUMP_MEMORY) == 0)
+            {
+                dumpMemoryUsage();
+            }
         }
         
     protected:
@@ -255,12 +297,26 @@ namespace touch_ndn {
         // Queue will be executed until empty.
         // Callbacks should follow certain signature
         std::queue<ExecuteCallback> executeQueue_;
+        std::vector<std::pair<std::string, std::shared_ptr<MemoryCounter>>> memoryCounters_;
         
         void dispatchOnExecute(ExecuteCallback clbck)
         {
             executeQueue_.push(clbck);
         }
         
+        // returns counter for memory held by this op under given category; each category
+        // is reported in info CHOP (as memory<Category>Bytes) and in dumpMemoryUsage()
+        std::shared_ptr<MemoryCounter> trackMemory(const std::string& category)
+        {
+            std::shared_ptr<MemoryCounter> counter = getMemoryCounter(this, category);
+            
+            for (auto &c:memoryCounters_)
+                if (c.first == category)
+                    return counter;
+            memoryCounters_.push_back(std::make_pair(category, counter));
+            return counter;
+        }
+        
         // override in subclasses
         virtual void initPulsed() {}
         // override in subclasses. should add udpated params names into the set
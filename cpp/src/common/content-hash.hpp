@@ -0,0 +1,44 @@
+/**
+ * Copyright (C) 2019 Regents of the University of California.
+ * @author: Peter Gusev <peter@remap.ucla.edu>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version, with the additional exemption that
+ * compiling, linking, and/or using OpenSSL is allowed.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * A copy of the GNU Lesser General Public License is in the file COPYING.
+ */
+
+#ifndef content_hash_hpp
+#define content_hash_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define XXH_INLINE_ALL
+#include "contrib/xxhash/xxhash.h"
+
+namespace touch_ndn {
+
+    /**
+     * Fast non-cryptographic hash (XXH3, vectorized with SSE2/AVX2 or NEON, depending
+     * on the target) for detecting changes in op inputs. Not suitable for anything
+     * security-related. Hashes of several pieces can be chained by passing previous
+     * hash as a seed.
+     */
+    inline uint64_t contentHash(const void* data, size_t len, uint64_t seed = 0)
+    {
+        return XXH3_64bits_withSeed(data, len, seed);
+    }
+}
+
+#endif /* content_hash_hpp */
@@ -14,9 +14,17 @@
 #include <condition_variable>
 #include <atomic>
 #include <chrono>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <deque>
+#include <array>
+#include <future>
 
 #include <boost/asio.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <ndn-cpp/threadsafe-face.hpp>
 #include <ndn-cpp/face.hpp>
@@ -25,8 +33,27 @@
 #include <ndn-cpp/security/identity/memory-private-key-storage.hpp>
 #include <ndn-cpp/security/pib/pib-memory.hpp>
 #include <ndn-cpp/security/tpm/tpm-back-end-memory.hpp>
+#include <touchndn-helper/helper.hpp>
 
 #define USE_THREADSAFE_FACE
+#define FACE_THREAD_NAME "ndn-face"
+// handlers registered within this window are registered with NFD in one batch
+#define PREFIX_BATCH_WINDOW_MS 20
+// socket polling interval bounds for non-ThreadsafeFace event-driven mode
+#define POLL_INTERVAL_MIN_US 100
+#define POLL_INTERVAL_MAX_US 5000
+// completion pool block sizes are powers of two starting from 1<<MIN_BLOCK_SHIFT,
+// larger requests go to the heap directly
+#define MIN_BLOCK_SHIFT 6
+#define BLOCK_CLASSES_NUM 4
+// delay before re-creating failed Face; doubles on every consecutive failure
+#define RECOVERY_BACKOFF_MIN_MS 10
+#define RECOVERY_BACKOFF_MAX_MS 5000
+// shortest delay pacing timer is scheduled for
+#define PACING_TIMER_MIN_US 500
+#define DATA_PRIORITY_NUM 4
+// queued Data waiting longer than this is sent ahead of higher priority classes
+#define DATA_MAX_WAIT_MS 100
 
 using namespace ndn;
 using namespace std;
@@ -35,15 +62,56 @@ using namespace touch_ndn::helpers;
 
 namespace touch_ndn {
     namespace helpers {
+        namespace detail {
+            typedef struct _TokenBucket {
+                _TokenBucket(): rate_(0), burst_(1), tokens_(1) {}
+                
+                double rate_, burst_, tokens_;
+                std::chrono::steady_clock::time_point lastTs_;
+                
+                void setOptions(double rate, double burst)
+                {
+                    rate_ = rate;
+                    burst_ = max(1., burst);
+                    tokens_ = min(tokens_, burst_);
+                }
+                void refill(const std::chrono::steady_clock::time_point& now)
+                {
+                    if (rate_ > 0)
+                        tokens_ = min(burst_, tokens_ + rate_ * std::chrono::duration<double>(now - lastTs_).count());
+                    lastTs_ = now;
+                }
+                // requests larger than burst may go once bucket is full, leaving it in debt
+                bool hasTokens(double n = 1) const { return rate_ <= 0 || tokens_ >= min(n, burst_); }
+                void take(double n = 1) { if (rate_ > 0) tokens_ -= n; }
+                // returns time till there are enough tokens, in microseconds
+                uint64_t getWaitUs(double n = 1) const
+                { return hasTokens(n) ? 0 : (uint64_t)ceil((min(n, burst_) - tokens_) / rate_ * 1E6); }
+            } TokenBucket;
+            
+            // global budget is shared by processing threads of all FaceProcessors
+            static mutex GlobalBucketMtx;
+            static TokenBucket GlobalBucket;
+        }
+        
         class FaceProcessorImpl : public enable_shared_from_this<FaceProcessorImpl>{
         public:
-            FaceProcessorImpl(string host, OnFaceReset onFaceReset);
+            FaceProcessorImpl(string host, OnFaceReset onFaceReset, OnFaceRecovered onFaceRecovered);
             ~FaceProcessorImpl();
 
             void start();
             void stop();
             bool isProcessing();
             uint64_t getLastProcessingCallTimestamp() const { return processEventsTimestamp_; }
+            
+            void setProcessingMode(FaceProcessor::ProcessingMode mode);
+            FaceProcessor::ProcessingMode getProcessingMode() const
+            { return busyPoll_ ? FaceProcessor::ProcessingMode::BusyPoll : FaceProcessor::ProcessingMode::EventDriven; }
+            uint32_t getDispatchLatencyAvgUs() const { return dispatchLatencyAvgUs_; }
+            uint32_t getDispatchLatencyMaxUs() const { return dispatchLatencyMaxUs_; }
+            void setThreadOptions(const ThreadOptions& options);
+            uint64_t getThreadCpuTimeUs()
+            { return isRunningFace_ ? helpers::getThreadCpuTimeUs(t_.native_handle()) : 0; }
 
             // non blocking
             void dispatchSynchronized(function<void(shared_ptr<ndn::Face>)> dispatchBlock);
@@ -56,18 +124,257 @@ namespace touch_ndn {
             io_service& getIo() { return io_; }
             shared_ptr<Face> getFace() { return face_; }
             
+            uint64_t registerHandler(const Name& prefix, const OnInterestCallback& onInterest,
+                                     const OnRegisterFailed& onRegisterFailed,
+                                     const OnRegisterSuccess& onRegisterSuccess);
+            void unregisterHandler(uint64_t handlerId);
+            void setAggregatePrefix(const Name& prefix);
+            size_t getNfdRegistrationsNum() const { return nNfdRegistrations_; }
+            size_t getHandlersNum() const { return nHandlers_; }
+            
+            uint64_t expressInterest(const Interest& interest, const OnData& onData,
+                                     const OnTimeout& onTimeout, const OnNetworkNack& onNetworkNack,
+                                     uint64_t pacerId);
+            void removePendingInterest(uint64_t pendingInterestId);
+            uint64_t addPacer(const PacingOptions& options);
+            void setPacer(uint64_t pacerId, const PacingOptions& options);
+            void removePacer(uint64_t pacerId);
+            size_t getPacerQueueSize(uint64_t pacerId) const;
+            uint32_t getPacerDelayUs(uint64_t pacerId) const;
+            void putData(const shared_ptr<const Data>& data, DataPriority priority);
+            void setDataShaping(const DataShapingOptions& options);
+            size_t getDataQueueSize() const { return nDataQueued_; }
+            size_t getDataQueueBytes() const { return nDataQueuedBytes_; }
+            uint32_t getDataDelayUs() const { return dataDelayAvgUs_; }
+            uint64_t getDataDroppedNum() const { return nDataDropped_; }
+            uint64_t getInterestsAggregatedNum() const { return nInterestsAggregated_; }
+            uint64_t getInterestsExpressedNum() const { return nInterestsExpressed_; }
+            size_t getPendingInterestsNum() const { return nPitEntries_; }
+            void setCommandKeyChain(const shared_ptr<KeyChain>& keyChain);
+            uint64_t getFaceResetsNum() const { return nFaceResets_; }
+            bool isRecovering() const { return recovering_; }
+            uint64_t getLastRecoveryTimeMs() const { return lastRecoveryTimeMs_; }
+            
         private:
+            typedef struct _NfdRegistration {
+                enum class State { Batched, Pending, Registered };
+                
+                State state_;
+                Name prefix_;
+                uint64_t registeredPrefixId_;
+                set<uint64_t> handlers_;
+            } NfdRegistration;
+            
+            typedef struct _PrefixHandler {
+                uint64_t id_;
+                shared_ptr<const Name> prefix_;
+                OnInterestCallback onInterest_;
+                OnRegisterFailed onRegisterFailed_;
+                OnRegisterSuccess onRegisterSuccess_;
+                shared_ptr<NfdRegistration> registration_;
+            } PrefixHandler;
+            
+            typedef struct _TrieNode {
+                map<Name::Component, unique_ptr<_TrieNode>> children_;
+                vector<shared_ptr<PrefixHandler>> handlers_;
+            } TrieNode;
+            
+            typedef struct _PitConsumer {
+                shared_ptr<const Interest> interest_;
+                OnData onData_;
+                OnTimeout onTimeout_;
+                OnNetworkNack onNetworkNack_;
+            } PitConsumer;
+            
+            typedef struct _PitEntry {
+                string key_;
+                uint64_t pendingInterestId_;
+                map<uint64_t, PitConsumer> consumers_;
+            } PitEntry;
+            
+            typedef struct _QueuedConsumer {
+                uint64_t id_;
+                PitConsumer consumer_;
+                std::chrono::steady_clock::time_point enqueueTs_;
+            } QueuedConsumer;
+            
+            typedef struct _Pacer {
+                _Pacer(): nQueued_(0), delayAvgUs_(0) {}
+                
+                detail::TokenBucket bucket_;
+                // may contain consumers removed while queued, these are skipped
+                deque<QueuedConsumer> queue_;
+                atomic<size_t> nQueued_;
+                atomic<uint32_t> delayAvgUs_;
+            } Pacer;
+            
+
             uint64_t processEventsTimestamp_;
             string host_;
             OnFaceReset onFaceReset_;
+            OnFaceRecovered onFaceRecovered_;
             shared_ptr<Face> face_;
             thread t_;
             bool isRunningFace_;
             io_service io_;
 #ifdef USE_THREADSAFE_FACE
             shared_ptr<io_service::work> ioWork_;
+#else
+            // wakes up processing thread when a block is dispatched
+            mutex wakeupMtx_;
+            condition_variable wakeupCv_;
+            bool wakeupPending_;
 #endif
+            atomic<bool> busyPoll_;
+            atomic<uint32_t> dispatchLatencyAvgUs_, dispatchLatencyMaxUs_;
+            
+            void wakeup();
+            void processingLoop();
+            void updateDispatchLatency(const std::chrono::steady_clock::time_point& dispatchTs);
+            
+            // Face recovery state; recovering_ and counters are read from other threads
+            mutex recoveryMtx_;
+            condition_variable recoveryCv_;
+            atomic<bool> recovering_;
+            atomic<uint64_t> nFaceResets_, lastRecoveryTimeMs_;
+            std::chrono::steady_clock::time_point recoveryStartTs_;
+            uint32_t recoveryBackoffMs_;
+            bool restorePending_;
+            shared_ptr<KeyChain> commandKeyChain_;
+            
+            void recover(const exception& e);
+            void restoreState();
+            void onRecoveryConfirmed();
+            void applyCommandKeyChain();
+            
+            // prefix registry, accessed on the processing thread only (code dispatched there
+            // captures raw this: queued handlers never run after stop(), which precedes destruction)
+            TrieNode trieRoot_;
+            map<uint64_t, shared_ptr<PrefixHandler>> handlers_;
+            vector<shared_ptr<NfdRegistration>> nfdRegistrations_;
+            Name aggregatePrefix_;
+            steady_timer batchTimer_;
+            bool batchScheduled_;
+            atomic<uint64_t> lastHandlerId_;
+            atomic<size_t> nNfdRegistrations_, nHandlers_;
+            
+            // local pending Interest table, accessed on the processing thread only
+            unordered_map<string, shared_ptr<PitEntry>> pit_;
+            unordered_map<uint64_t, shared_ptr<PitEntry>> pitConsumers_;
+            atomic<uint64_t> lastPendingInterestId_, nInterestsAggregated_, nInterestsExpressed_;
+            atomic<size_t> nPitEntries_;
+            
+            // Interest pacers, modified on the processing thread only; map is guarded by
+            // pacersMtx_ as pacers' stats are read from other threads
+            mutable mutex pacersMtx_;
+            map<uint64_t, shared_ptr<Pacer>> pacers_;
+            // queued consumer id -> pacer id
+            unordered_map<uint64_t, uint64_t> queuedConsumers_;
+            atomic<uint64_t> lastPacerId_;
+            steady_timer pacingTimer_;
+            bool pacingScheduled_;
+            
+            typedef struct _QueuedData {
+                shared_ptr<const Data> data_;
+                // name of the frame (segmented object) packet belongs to
+                Name frame_;
+                size_t size_;
+                std::chrono::steady_clock::time_point enqueueTs_;
+            } QueuedData;
+            
+            // outgoing Data scheduler, accessed on the processing thread only
+            array<deque<QueuedData>, DATA_PRIORITY_NUM> dataQueues_;
+            // latest frame dropped from each queue, its remaining packets are dropped as well
+            array<Name, DATA_PRIORITY_NUM> droppedFrames_;
+            detail::TokenBucket dataBucket_;
+            size_t dataQueueLimit_;
+            steady_timer dataTimer_;
+            bool dataScheduled_;
+            atomic<size_t> nDataQueued_, nDataQueuedBytes_;
+            atomic<uint32_t> dataDelayAvgUs_;
+            atomic<uint64_t> nDataDropped_;
+            
+            void drainData();
+            // drops whole frames until queued bytes fit the limit
+            void trimData();
+            // returns queue to send next packet from, -1 if all are empty
+            int nextDataQueue(const std::chrono::steady_clock::time_point& now) const;
+            
+            string getPitKey(const Interest& i) const;
+            void enqueuePitConsumer(uint64_t id, PitConsumer consumer, uint64_t pacerId);
+            void drainPacers();
+            shared_ptr<Pacer> getPacer(uint64_t pacerId) const;
+            
+            void addPitConsumer(uint64_t id, PitConsumer consumer);
+            void expressPitEntry(const shared_ptr<PitEntry>& entry);
+            void removePitConsumer(uint64_t id);
+            // removes entry and returns its consumers
+            map<uint64_t, PitConsumer> satisfyPitEntry(const shared_ptr<PitEntry>& entry);
+            
+            void addHandler(shared_ptr<PrefixHandler> h);
+            void removeHandler(uint64_t handlerId);
+            void attachHandler(const shared_ptr<PrefixHandler>& h, const shared_ptr<NfdRegistration>& reg);
+            shared_ptr<NfdRegistration> findCoveringRegistration(const Name& n) const;
+            void removeRegistration(const shared_ptr<NfdRegistration>& reg);
+            void flushBatch();
+            void registerWithNfd(const shared_ptr<NfdRegistration>& reg);
+            void absorbCovered(const shared_ptr<NfdRegistration>& cover);
+            void dispatchInterest(const shared_ptr<const Interest>& interest, Face& face,
+                                  const shared_ptr<const InterestFilter>& filter);
+            
+            void trieInsert(const shared_ptr<PrefixHandler>& h);
+            void trieRemove(const shared_ptr<PrefixHandler>& h);
         };
+
+        namespace detail {
+            // Face, which sends Interests through FaceProcessor's PIT and pacer; the rest of
+            // the Face API used by consumers (timers) goes to the processing thread's Face.
+            // Base Face's own transport is never connected.
+            class PacingFace : public Face {
+            public:
+                PacingFace(const shared_ptr<FaceProcessorImpl>& processor, Face& face, uint64_t pacerId)
+                : processor_(processor), face_(face), pacerId_(pacerId) {}
+
+                using Face::expressInterest;
+
+                uint64_t expressInterest(const Interest& interest, const ndn::OnData& onData,
+                                         const ndn::OnTimeout& onTimeout,
+                                         const ndn::OnNetworkNack& onNetworkNack,
+                                         WireFormat& wireFormat = *WireFormat::getDefaultWireFormat()) override
+                {
+                    shared_ptr<FaceProcessorImpl> p = processor_.lock();
+                    return p ? p->expressInterest(interest, onData, onTimeout, onNetworkNack, pacerId_) : 0;
+                }
+
+                uint64_t expressInterest(const Name& name, const Interest *interestTemplate,
+                                         const ndn::OnData& onData, const ndn::OnTimeout& onTimeout,
+                                         const ndn::OnNetworkNack& onNetworkNack,
+                                         WireFormat& wireFormat = *WireFormat::getDefaultWireFormat()) override
+                {
+                    Interest interest(name);
+                    if (interestTemplate)
+                    {
+                        interest = *interestTemplate;
+                        interest.setName(name);
+                    }
+                    return expressInterest(interest, onData, onTimeout, onNetworkNack, wireFormat);
+                }
+
+                void removePendingInterest(uint64_t pendingInterestId) override
+                {
+                    shared_ptr<FaceProcessorImpl> p = processor_.lock();
+                    if (p) p->removePendingInterest(pendingInterestId);
+                }
+
+                void callLater(Milliseconds delayMilliseconds, const Callback& callback) override
+                { face_.callLater(delayMilliseconds, callback); }
+
+            private:
+                weak_ptr<FaceProcessorImpl> processor_;
+                Face &face_;
+                uint64_t pacerId_;
+            };
+        }
     }
 }
 
@@ -125,6 +432,9 @@ FaceProcessor::FaceProcessor(string host)
     pimpl_ = make_shared<FaceProcessorImpl>(host,
                                             [this](const shared_ptr<Face>&f, const exception& e){
                                                 onFaceReset_(f, e);
+                                            },
+                                            [this](const shared_ptr<Face>&f){
+                                                onFaceRecovered_(f);
                                             });
     if (pimpl_->initFace())
         pimpl_->runFace();
@@ -141,6 +451,12 @@ void FaceProcessor::start() { pimpl_->start(); }
 void FaceProcessor::stop() { pimpl_->stop(); }
 bool FaceProcessor::isProcessing() { return pimpl_->isProcessing(); }
 uint64_t FaceProcessor::getLastProcessingCallTimestamp() const { return pimpl_->getLastProcessingCallTimestamp(); }
+void FaceProcessor::setProcessingMode(ProcessingMode mode) { pimpl_->setProcessingMode(mode); }
+FaceProcessor::ProcessingMode FaceProcessor::getProcessingMode() const { return pimpl_->getProcessingMode(); }
+void FaceProcessor::setThreadOptions(const ThreadOptions& options) { pimpl_->setThreadOptions(options); }
+uint64_t FaceProcessor::getThreadCpuTimeUs() { return pimpl_->getThreadCpuTimeUs(); }
+uint32_t FaceProcessor::getDispatchLatencyAvgUs() const { return pimpl_->getDispatchLatencyAvgUs(); }
+uint32_t FaceProcessor::getDispatchLatencyMaxUs() const { return pimpl_->getDispatchLatencyMaxUs(); }
 void FaceProcessor::dispatchSynchronized(function<void (shared_ptr<Face>)> dispatchBlock)
 {
     return pimpl_->dispatchSynchronized(dispatchBlock);
@@ -157,36 +473,228 @@ void FaceProcessor::registerPrefix(const Name& prefix,
                                    const OnRegisterFailed& onRegisterFailed,
                                    const OnRegisterSuccess& onRegisterSuccess)
 {
-    pimpl_->performSynchronized([prefix, onInterest, onRegisterFailed, onRegisterSuccess](shared_ptr<ndn::Face> face){
+    pimpl_->dispatchSynchronized([prefix, onInterest, onRegisterFailed, onRegisterSuccess](shared_ptr<ndn::Face> face){
         face->registerPrefix(prefix, onInterest, onRegisterFailed, onRegisterSuccess);
     });
 }
 
+future<uint64_t> FaceProcessor::registerPrefixAsync(const ndn::Name& prefix,
+                                                    const OnInterestCallback& onInterest)
+{
+    shared_ptr<detail::Completion<uint64_t>> c = detail::makeCompletion<uint64_t>();
+    future<uint64_t> f = c->promise_.get_future();
+    
+    pimpl_->dispatchSynchronized([prefix, onInterest, c](shared_ptr<ndn::Face> face){
+        face->registerPrefix(prefix, onInterest,
+                             [c](const shared_ptr<const Name>& prefix){
+                                 c->promise_.set_exception(make_exception_ptr(runtime_error("failed to register prefix "+prefix->toUri())));
+                             },
+                             [c](const shared_ptr<const Name>&, uint64_t registeredPrefixId){
+                                 c->promise_.set_value(registeredPrefixId);
+                             });
+    });
+    
+    return f;
+}
+
+uint64_t FaceProcessor::registerHandler(const ndn::Name& prefix,
+                                        const OnInterestCallback& onInterest,
+                                        const OnRegisterFailed& onRegisterFailed,
+                                        const OnRegisterSuccess& onRegisterSuccess)
+{
+    return pimpl_->registerHandler(prefix, onInterest, onRegisterFailed, onRegisterSuccess);
+}
+
+void FaceProcessor::unregisterHandler(uint64_t handlerId) { pimpl_->unregisterHandler(handlerId); }
+void FaceProcessor::setAggregatePrefix(const ndn::Name& prefix) { pimpl_->setAggregatePrefix(prefix); }
+size_t FaceProcessor::getNfdRegistrationsNum() const { return pimpl_->getNfdRegistrationsNum(); }
+size_t FaceProcessor::getHandlersNum() const { return pimpl_->getHandlersNum(); }
+
+uint64_t FaceProcessor::expressInterest(const ndn::Interest& interest,
+                                        const OnData& onData,
+                                        const OnTimeout& onTimeout,
+                                        const OnNetworkNack& onNetworkNack,
+                                        uint64_t pacerId)
+{
+    return pimpl_->expressInterest(interest, onData, onTimeout, onNetworkNack, pacerId);
+}
+
+void FaceProcessor::removePendingInterest(uint64_t pendingInterestId) { pimpl_->removePendingInterest(pendingInterestId); }
+uint64_t FaceProcessor::addPacer(const PacingOptions& options) { return pimpl_->addPacer(options); }
+void FaceProcessor::setPacer(uint64_t pacerId, const PacingOptions& options) { pimpl_->setPacer(pacerId, options); }
+void FaceProcessor::removePacer(uint64_t pacerId) { pimpl_->removePacer(pacerId); }
+size_t FaceProcessor::getPacerQueueSize(uint64_t pacerId) const { return pimpl_->getPacerQueueSize(pacerId); }
+uint32_t FaceProcessor::getPacerDelayUs(uint64_t pacerId) const { return pimpl_->getPacerDelayUs(pacerId); }
+
+void FaceProcessor::putData(const shared_ptr<const Data>& data, DataPriority priority) { pimpl_->putData(data, priority); }
+void FaceProcessor::setDataShaping(const DataShapingOptions& options) { pimpl_->setDataShaping(options); }
+size_t FaceProcessor::getDataQueueSize() const { return pimpl_->getDataQueueSize(); }
+size_t FaceProcessor::getDataQueueBytes() const { return pimpl_->getDataQueueBytes(); }
+uint32_t FaceProcessor::getDataDelayUs() const { return pimpl_->getDataDelayUs(); }
+uint64_t FaceProcessor::getDataDroppedNum() const { return pimpl_->getDataDroppedNum(); }
+
+void FaceProcessor::setGlobalPacing(const PacingOptions& options)
+{
+    lock_guard<mutex> scopedLock(detail::GlobalBucketMtx);
+    detail::GlobalBucket.setOptions(options.rate_, options.burst_);
+}
+
+shared_ptr<Face> FaceProcessor::makePacingFace(Face& face, uint64_t pacerId)
+{
+    return make_shared<detail::PacingFace>(pimpl_, face, pacerId);
+}
+
+future<InterestResult> FaceProcessor::expressInterestAsync(const ndn::Interest& interest)
+{
+    shared_ptr<detail::Completion<InterestResult>> c = detail::makeCompletion<InterestResult>();
+    future<InterestResult> f = c->promise_.get_future();
+    
+    pimpl_->expressInterest(interest,
+                            [c](const shared_ptr<const Interest>& i, const shared_ptr<Data>& d){
+                                c->promise_.set_value({InterestResult::Status::Data, i, d, nullptr});
+                            },
+                            [c](const shared_ptr<const Interest>& i){
+                                c->promise_.set_value({InterestResult::Status::Timeout, i, nullptr, nullptr});
+                            },
+                            [c](const shared_ptr<const Interest>& i, const shared_ptr<NetworkNack>& n){
+                                c->promise_.set_value({InterestResult::Status::Nack, i, nullptr, n});
+                            }, 0);
+    
+    return f;
+}
+uint64_t FaceProcessor::getInterestsAggregatedNum() const { return pimpl_->getInterestsAggregatedNum(); }
+uint64_t FaceProcessor::getInterestsExpressedNum() const { return pimpl_->getInterestsExpressedNum(); }
+size_t FaceProcessor::getPendingInterestsNum() const { return pimpl_->getPendingInterestsNum(); }
+void FaceProcessor::setCommandKeyChain(const shared_ptr<KeyChain>& keyChain) { pimpl_->setCommandKeyChain(keyChain); }
+uint64_t FaceProcessor::getFaceResetsNum() const { return pimpl_->getFaceResetsNum(); }
+bool FaceProcessor::isRecovering() const { return pimpl_->isRecovering(); }
+uint64_t FaceProcessor::getLastRecoveryTimeMs() const { return pimpl_->getLastRecoveryTimeMs(); }
+
 void FaceProcessor::registerPrefixBlocking(const ndn::Name& prefix, 
                 const OnInterestCallback& onInterest,
                 const OnRegisterFailed& onRegisterFailed,
                 const OnRegisterSuccess& onRegisterSuccess)
 {
-    mutex m;
-    unique_lock<mutex> lock(m);
-    condition_variable isDone;
-    atomic<bool> completed(false);
-    bool registered = false;
+    shared_ptr<detail::Completion<void>> c = detail::makeCompletion<void>();
+    future<void> completed = c->promise_.get_future();
 
-    pimpl_->dispatchSynchronized([prefix, onInterest, onRegisterFailed, onRegisterSuccess](shared_ptr<ndn::Face> face){
-        face->registerPrefix(prefix, onInterest, onRegisterFailed, onRegisterSuccess);
+    pimpl_->dispatchSynchronized([prefix, onInterest, onRegisterFailed, onRegisterSuccess, c](shared_ptr<ndn::Face> face){
+        face->registerPrefix(prefix, onInterest,
+                             [onRegisterFailed, c](const shared_ptr<const Name>& prefix){
+                                 if (onRegisterFailed) onRegisterFailed(prefix);
+                                 c->promise_.set_value();
+                             },
+                             [onRegisterSuccess, c](const shared_ptr<const Name>& prefix, uint64_t registeredPrefixId){
+                                 if (onRegisterSuccess) onRegisterSuccess(prefix, registeredPrefixId);
+                                 c->promise_.set_value();
+                             });
     });
 
-    isDone.wait(lock, [&completed](){ return completed.load(); });
+    // returns also if the Face stops before registration completes (broken promise)
+    completed.wait();
 }
 
 //******************************************************************************
-FaceProcessorImpl::FaceProcessorImpl(string host, OnFaceReset onFaceReset)
+namespace touch_ndn {
+    namespace helpers {
+        namespace detail {
+            typedef struct _FreeBlock {
+                struct _FreeBlock *next_;
+            } FreeBlock;
+            
+            typedef struct _BlockClass {
+                mutex mtx_;
+                FreeBlock *head_ = nullptr;
+            } BlockClass;
+            
+            static BlockClass BlockClasses[BLOCK_CLASSES_NUM];
+            
+            static int blockClassIdx(size_t size)
+            {
+                for (int i = 0; i < BLOCK_CLASSES_NUM; ++i)
+                    if (size <= ((size_t)1 << (MIN_BLOCK_SHIFT + i)))
+                        return i;
+                return -1;
+            }
+            
+            void* BlockPool::allocate(size_t size)
+            {
+                int idx = blockClassIdx(size);
+                if (idx < 0)
+                    return ::operator new(size);
+                
+                {
+                    BlockClass &bc = BlockClasses[idx];
+                    lock_guard<mutex> scopedLock(bc.mtx_);
+                    if (bc.head_)
+                    {
+                        FreeBlock *b = bc.head_;
+                        bc.head_ = b->next_;
+                        return b;
+                    }
+                }
+                
+                return ::operator new((size_t)1 << (MIN_BLOCK_SHIFT + idx));
+            }
+            
+            void BlockPool::deallocate(void* p, size_t size)
+            {
+                int idx = blockClassIdx(size);
+                if (idx < 0)
+                {
+                    ::operator delete(p);
+                    return;
+                }
+                
+                BlockClass &bc = BlockClasses[idx];
+                lock_guard<mutex> scopedLock(bc.mtx_);
+                FreeBlock *b = static_cast<FreeBlock*>(p);
+                b->next_ = bc.head_;
+                bc.head_ = b;
+            }
+        }
+    }
+}
+
+//******************************************************************************
+FaceProcessorImpl::FaceProcessorImpl(string host, OnFaceReset onFaceReset, OnFaceRecovered onFaceRecovered)
 : host_(host)
 , isRunningFace_(false)
 , processEventsTimestamp_(0)
 , onFaceReset_(onFaceReset)
+, onFaceRecovered_(onFaceRecovered)
+#ifndef USE_THREADSAFE_FACE
+, wakeupPending_(false)
+#endif
+, busyPoll_(false)
+, dispatchLatencyAvgUs_(0)
+, dispatchLatencyMaxUs_(0)
+, recovering_(false)
+, nFaceResets_(0)
+, lastRecoveryTimeMs_(0)
+, recoveryBackoffMs_(RECOVERY_BACKOFF_MIN_MS)
+, restorePending_(false)
+, batchTimer_(io_)
+, batchScheduled_(false)
+, lastHandlerId_(0)
+, nNfdRegistrations_(0)
+, nHandlers_(0)
+, lastPendingInterestId_(0)
+, nInterestsAggregated_(0)
+, nInterestsExpressed_(0)
+, nPitEntries_(0)
+, lastPacerId_(0)
+, pacingTimer_(io_)
+, pacingScheduled_(false)
+, dataQueueLimit_(0)
+, dataTimer_(io_)
+, dataScheduled_(false)
+, nDataQueued_(0)
+, nDataQueuedBytes_(0)
+, dataDelayAvgUs_(0)
+, nDataDropped_(0)
 {
+    pacers_[0] = make_shared<Pacer>();
 }
 
 FaceProcessorImpl::~FaceProcessorImpl()
@@ -206,6 +714,11 @@ void FaceProcessorImpl::stop()
     if (isRunningFace_)
     {
         isRunningFace_ = false;
+        {
+            // interrupt recovery backoff, if any
+            lock_guard<mutex> scopedLock(recoveryMtx_);
+        }
+        recoveryCv_.notify_all();
         
 #ifdef USE_THREADSAFE_FACE
         face_->shutdown();
@@ -231,10 +744,20 @@ void FaceProcessorImpl::dispatchSynchronized(function<void (shared_ptr<ndn::Face
 {
     if (isRunningFace_)
     {
-        shared_ptr<Face> f = face_;
-        io_.dispatch([dispatchBlock, f](){
-            dispatchBlock(f);
-        });
+        // blocks get Face at execution time, as it may be re-created while they're queued
+        if (this_thread::get_id() == t_.get_id())
+            io_.dispatch([this, dispatchBlock](){
+                dispatchBlock(face_);
+            });
+        else
+        {
+            std::chrono::steady_clock::time_point dispatchTs = std::chrono::steady_clock::now();
+            io_.dispatch([this, dispatchBlock, dispatchTs](){
+                updateDispatchLatency(dispatchTs);
+                dispatchBlock(face_);
+            });
+            wakeup();
+        }
     }
 }
 
@@ -246,19 +769,19 @@ void FaceProcessorImpl::performSynchronized(function<void (shared_ptr<ndn::Face>
             dispatchBlock(face_);
         else
         {
-            mutex m;
-            unique_lock<mutex> lock(m);
-            condition_variable isDone;
-            atomic<bool> doneFlag(false);
-            shared_ptr<Face> face = face_;
-            
-            io_.dispatch([dispatchBlock, face, &isDone, &doneFlag](){
-                dispatchBlock(face);
-                doneFlag = true;
-                isDone.notify_one();
+            shared_ptr<detail::Completion<void>> c = detail::makeCompletion<void>();
+            future<void> isDone = c->promise_.get_future();
+            
+            dispatchSynchronized([c, dispatchBlock](shared_ptr<Face> face) mutable {
+                c->run(dispatchBlock, face);
             });
             
-            isDone.wait(lock, [&doneFlag](){ return doneFlag.load(); });
+            try {
+                isDone.get();
+            }
+            catch (future_error &e) {
+                // processing stopped before block was executed
+            }
         }
     }
 }
@@ -296,37 +819,981 @@ void FaceProcessorImpl::runFace()
     isRunningFace_ = false;
     
     shared_ptr<FaceProcessorImpl> self = shared_from_this();
+    promise<void> started;
+    future<void> isStarted = started.get_future();
     
-    t_ = thread([self](){
+    t_ = thread([self, &started](){
+        ThreadOptions defaultOptions;
+        defaultOptions.name_ = FACE_THREAD_NAME;
+        applyThreadOptions(defaultOptions);
+        
         self->isRunningFace_ = true;
+        started.set_value();
+        
         while (self->isRunningFace_)
         {
             try {
+                if (self->restorePending_)
+                {
+                    self->restorePending_ = false;
+                    if (self->onFaceRecovered_)
+                        self->onFaceRecovered_(self->face_);
+                    self->restoreState();
+                }
+                
+                self->processingLoop();
+            }
+            catch (exception &e) {
+                self->recover(e);
+            }
+        }
+    });
+    
+    isStarted.wait();
+}
+
+void FaceProcessorImpl::processingLoop()
+{
 #ifdef USE_THREADSAFE_FACE
-                self->io_.run();
-                self->isRunningFace_ = false;
+    // ThreadsafeFace delivers network events through io_, so io_ is the only thing
+    // to wait on; run handlers one by one to pick up processing mode changes
+    while (isRunningFace_)
+    {
+        if (busyPoll_)
+        {
+            io_.poll();
+            if (io_.stopped())
+                break;
+        }
+        else if (!io_.run_one())
+            break;
+        
+        processEventsTimestamp_ = ndn_getNowMilliseconds();
+    }
+    isRunningFace_ = false;
 #else
-                self->io_.poll();
-                self->io_.reset();
-                self->face_->processEvents();
-                self->processEventsTimestamp_ = ndn_getNowMilliseconds();
-                usleep(5000);
+    // plain Face doesn't expose its socket, so it has to be polled; sleep in between,
+    // backing off while idle, unless woken up by dispatched block
+    uint32_t pollIntervalUs = POLL_INTERVAL_MIN_US;
+    
+    while (isRunningFace_)
+    {
+        size_t nHandlers = io_.poll();
+        io_.reset();
+        face_->processEvents();
+        processEventsTimestamp_ = ndn_getNowMilliseconds();
+        
+        if (busyPoll_)
+            continue;
+        
+        if (nHandlers || nPitEntries_)
+            pollIntervalUs = POLL_INTERVAL_MIN_US;
+        else
+            pollIntervalUs = min(2*pollIntervalUs, (uint32_t)POLL_INTERVAL_MAX_US);
+        
+        unique_lock<mutex> lock(wakeupMtx_);
+        wakeupCv_.wait_for(lock, std::chrono::microseconds(pollIntervalUs), [this](){ return wakeupPending_; });
+        wakeupPending_ = false;
+    }
 #endif
+}
+
+void FaceProcessorImpl::wakeup()
+{
+#ifndef USE_THREADSAFE_FACE
+    {
+        lock_guard<mutex> scopedLock(wakeupMtx_);
+        wakeupPending_ = true;
+    }
+    wakeupCv_.notify_one();
+#endif
+}
+
+void FaceProcessorImpl::setProcessingMode(FaceProcessor::ProcessingMode mode)
+{
+    busyPoll_ = (mode == FaceProcessor::ProcessingMode::BusyPoll);
+    dispatchLatencyMaxUs_ = 0;
+    // kick processing thread so it picks up the mode
+    io_.post([](){});
+    wakeup();
+}
+
+void FaceProcessorImpl::setThreadOptions(const ThreadOptions& options)
+{
+    // thread options can only be applied by the thread itself (on macOS)
+    dispatchSynchronized([options](shared_ptr<Face>){
+        ThreadOptions o(options);
+        if (o.name_.empty())
+            o.name_ = FACE_THREAD_NAME;
+        applyThreadOptions(o);
+    });
+}
+
+void FaceProcessorImpl::updateDispatchLatency(const std::chrono::steady_clock::time_point& dispatchTs)
+{
+    uint32_t latencyUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - dispatchTs).count();
+    
+    // called on the processing thread only
+    dispatchLatencyAvgUs_ = (dispatchLatencyAvgUs_ ? (7*dispatchLatencyAvgUs_ + latencyUs) / 8 : latencyUs);
+    if (latencyUs > dispatchLatencyMaxUs_)
+        dispatchLatencyMaxUs_ = latencyUs;
+}
+
+//******************************************************************************
+// Face recovery
+void FaceProcessorImpl::recover(const exception& e)
+{
+    io_.reset();
+    nFaceResets_++;
+    
+    if (!recovering_)
+    {
+        recovering_ = true;
+        recoveryStartTs_ = std::chrono::steady_clock::now();
+        recoveryBackoffMs_ = RECOVERY_BACKOFF_MIN_MS;
+    }
+    else
+        // previous attempt failed
+        recoveryBackoffMs_ = min(2*recoveryBackoffMs_, (uint32_t)RECOVERY_BACKOFF_MAX_MS);
+    
+    {
+        // save face till we call observers
+        shared_ptr<Face> face = face_;
+        if (onFaceReset_)
+            onFaceReset_(face, e);
+    }
+    
+    {
+        unique_lock<mutex> lock(recoveryMtx_);
+        recoveryCv_.wait_for(lock, std::chrono::milliseconds(recoveryBackoffMs_),
+                             [this](){ return !isRunningFace_; });
+    }
+    
+    if (!isRunningFace_)
+        return;
+    
+    if (!initFace())
+    {
+        // if can't recover -- set the flag
+        isRunningFace_ = false;
+        return;
+    }
+    
+    // state is restored by processing loop, so that failure to restore is handled as Face failure
+    restorePending_ = true;
+}
+
+void FaceProcessorImpl::restoreState()
+{
+    bool awaitsRegistration = false;
+    
+    if (commandKeyChain_)
+        applyCommandKeyChain();
+    
+    // batched registrations will be registered when batch timer fires
+    for (auto &reg:nfdRegistrations_)
+        if (reg->state_ != NfdRegistration::State::Batched)
+        {
+            registerWithNfd(reg);
+            awaitsRegistration = true;
+        }
+    
+    for (auto &it:pit_)
+        expressPitEntry(it.second);
+    
+    if (!awaitsRegistration)
+        onRecoveryConfirmed();
+}
+
+void FaceProcessorImpl::setCommandKeyChain(const shared_ptr<KeyChain>& keyChain)
+{
+    dispatchSynchronized([this, keyChain](shared_ptr<Face>){
+        if (commandKeyChain_ && commandKeyChain_ != keyChain)
+            commandKeyChain_->setFace(nullptr);
+        commandKeyChain_ = keyChain;
+        applyCommandKeyChain();
+    });
+}
+
+void FaceProcessorImpl::applyCommandKeyChain()
+{
+    if (commandKeyChain_)
+    {
+        face_->setCommandSigningInfo(*commandKeyChain_, commandKeyChain_->getDefaultCertificateName());
+        commandKeyChain_->setFace(face_.get());
+    }
+    else
+        face_->setCommandSigningInfo(*(KeyChain*)0, Name());
+}
+
+void FaceProcessorImpl::onRecoveryConfirmed()
+{
+    if (recovering_)
+    {
+        lastRecoveryTimeMs_ = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - recoveryStartTs_).count();
+        recovering_ = false;
+    }
+}
+
+//******************************************************************************
+// prefix registry
+uint64_t FaceProcessorImpl::registerHandler(const Name& prefix, const OnInterestCallback& onInterest,
+                                            const OnRegisterFailed& onRegisterFailed,
+                                            const OnRegisterSuccess& onRegisterSuccess)
+{
+    shared_ptr<PrefixHandler> h = make_shared<PrefixHandler>();
+    h->id_ = ++lastHandlerId_;
+    h->prefix_ = make_shared<Name>(prefix);
+    h->onInterest_ = onInterest;
+    h->onRegisterFailed_ = onRegisterFailed;
+    h->onRegisterSuccess_ = onRegisterSuccess;
+    
+    dispatchSynchronized([this, h](shared_ptr<Face>){
+        addHandler(h);
+    });
+    
+    return h->id_;
+}
+
+void FaceProcessorImpl::unregisterHandler(uint64_t handlerId)
+{
+    dispatchSynchronized([this, handlerId](shared_ptr<Face>){
+        removeHandler(handlerId);
+    });
+}
+
+void FaceProcessorImpl::setAggregatePrefix(const Name& prefix)
+{
+    dispatchSynchronized([this, prefix](shared_ptr<Face>){
+        aggregatePrefix_ = prefix;
+    });
+}
+
+void FaceProcessorImpl::addHandler(shared_ptr<PrefixHandler> h)
+{
+    trieInsert(h);
+    handlers_[h->id_] = h;
+    nHandlers_ = handlers_.size();
+    
+    shared_ptr<NfdRegistration> reg = findCoveringRegistration(*h->prefix_);
+    if (!reg)
+    {
+        reg = make_shared<NfdRegistration>();
+        reg->state_ = NfdRegistration::State::Batched;
+        reg->prefix_ = (aggregatePrefix_.size() && aggregatePrefix_.isPrefixOf(*h->prefix_) ?
+                        aggregatePrefix_ : *h->prefix_);
+        reg->registeredPrefixId_ = 0;
+        nfdRegistrations_.push_back(reg);
+        nNfdRegistrations_ = nfdRegistrations_.size();
+        
+        if (!batchScheduled_)
+        {
+            batchScheduled_ = true;
+            weak_ptr<FaceProcessorImpl> me = shared_from_this();
+            batchTimer_.expires_from_now(std::chrono::milliseconds(PREFIX_BATCH_WINDOW_MS));
+            batchTimer_.async_wait([me](const boost::system::error_code& e){
+                shared_ptr<FaceProcessorImpl> self = me.lock();
+                if (self && e != boost::asio::error::operation_aborted)
+                    self->flushBatch();
+            });
+        }
+    }
+    
+    attachHandler(h, reg);
+}
+
+void FaceProcessorImpl::removeHandler(uint64_t handlerId)
+{
+    auto it = handlers_.find(handlerId);
+    if (it == handlers_.end())
+        return;
+    
+    shared_ptr<PrefixHandler> h = it->second;
+    trieRemove(h);
+    handlers_.erase(it);
+    nHandlers_ = handlers_.size();
+    
+    shared_ptr<NfdRegistration> reg = h->registration_;
+    h->registration_.reset();
+    if (reg)
+    {
+        reg->handlers_.erase(handlerId);
+        if (reg->handlers_.empty())
+        {
+            if (reg->state_ != NfdRegistration::State::Batched)
+                face_->removeRegisteredPrefix(reg->registeredPrefixId_);
+            removeRegistration(reg);
+        }
+    }
+}
+
+void FaceProcessorImpl::attachHandler(const shared_ptr<PrefixHandler>& h,
+                                      const shared_ptr<NfdRegistration>& reg)
+{
+    h->registration_ = reg;
+    reg->handlers_.insert(h->id_);
+    
+    if (reg->state_ == NfdRegistration::State::Registered && h->onRegisterSuccess_)
+        h->onRegisterSuccess_(h->prefix_, h->id_);
+}
+
+shared_ptr<FaceProcessorImpl::NfdRegistration>
+FaceProcessorImpl::findCoveringRegistration(const Name& n) const
+{
+    for (auto &reg:nfdRegistrations_)
+        if (reg->prefix_.isPrefixOf(n))
+            return reg;
+    return shared_ptr<NfdRegistration>();
+}
+
+void FaceProcessorImpl::removeRegistration(const shared_ptr<NfdRegistration>& reg)
+{
+    nfdRegistrations_.erase(remove(nfdRegistrations_.begin(), nfdRegistrations_.end(), reg),
+                            nfdRegistrations_.end());
+    nNfdRegistrations_ = nfdRegistrations_.size();
+}
+
+void FaceProcessorImpl::flushBatch()
+{
+    batchScheduled_ = false;
+    
+    vector<shared_ptr<NfdRegistration>> batch;
+    for (auto &reg:nfdRegistrations_)
+        if (reg->state_ == NfdRegistration::State::Batched)
+            batch.push_back(reg);
+    
+    // handlers may arrive in any order, so a prefix batched earlier may be covered
+    // by a shorter one batched later -- merge those into the shorter one
+    sort(batch.begin(), batch.end(),
+         [](const shared_ptr<NfdRegistration>& a, const shared_ptr<NfdRegistration>& b){
+             return a->prefix_.size() < b->prefix_.size();
+         });
+    
+    for (auto &reg:batch)
+    {
+        shared_ptr<NfdRegistration> cover;
+        for (auto &r:nfdRegistrations_)
+            if (r != reg && r->prefix_.isPrefixOf(reg->prefix_))
+            {
+                cover = r;
+                break;
             }
-            catch (exception &e) {
-                self->io_.reset();
-                // save face till we call observers
-                shared_ptr<Face> face = self->face_;
-                // notify about error and try to recover
-                if (!self->initFace())
-                    // if can't recover -- set the flag
-                    self->isRunningFace_ = false;
-                // call observers
-                if (self->onFaceReset_)
-                    self->onFaceReset_(face, e);
+        
+        if (cover)
+        {
+            for (auto hId:reg->handlers_)
+                attachHandler(handlers_[hId], cover);
+            removeRegistration(reg);
+        }
+    }
+    
+    for (auto &reg:batch)
+        if (reg->handlers_.size() &&
+            find(nfdRegistrations_.begin(), nfdRegistrations_.end(), reg) != nfdRegistrations_.end())
+            registerWithNfd(reg);
+}
+
+void FaceProcessorImpl::registerWithNfd(const shared_ptr<NfdRegistration>& reg)
+{
+    weak_ptr<FaceProcessorImpl> me = shared_from_this();
+    reg->state_ = NfdRegistration::State::Pending;
+    reg->registeredPrefixId_ =
+    face_->registerPrefix(reg->prefix_,
+                          [me](const shared_ptr<const Name>&, const shared_ptr<const Interest>& interest,
+                               Face& face, uint64_t, const shared_ptr<const InterestFilter>& filter){
+                              shared_ptr<FaceProcessorImpl> self = me.lock();
+                              if (self)
+                                  self->dispatchInterest(interest, face, filter);
+                          },
+                          [me, reg](const shared_ptr<const Name>&){
+                              shared_ptr<FaceProcessorImpl> self = me.lock();
+                              if (!self)
+                                  return;
+                              
+                              self->removeRegistration(reg);
+                              
+                              set<uint64_t> handlers;
+                              swap(handlers, reg->handlers_);
+                              for (auto hId:handlers)
+                              {
+                                  auto it = self->handlers_.find(hId);
+                                  if (it == self->handlers_.end())
+                                      continue;
+                                  
+                                  shared_ptr<PrefixHandler> h = it->second;
+                                  self->trieRemove(h);
+                                  self->handlers_.erase(it);
+                                  h->registration_.reset();
+                                  if (h->onRegisterFailed_)
+                                      h->onRegisterFailed_(h->prefix_);
+                              }
+                              self->nHandlers_ = self->handlers_.size();
+                          },
+                          [me, reg](const shared_ptr<const Name>&, uint64_t){
+                              shared_ptr<FaceProcessorImpl> self = me.lock();
+                              if (!self)
+                                  return;
+                              
+                              reg->state_ = NfdRegistration::State::Registered;
+                              self->onRecoveryConfirmed();
+                              set<uint64_t> handlers = reg->handlers_;
+                              for (auto hId:handlers)
+                              {
+                                  auto it = self->handlers_.find(hId);
+                                  if (it != self->handlers_.end() && it->second->onRegisterSuccess_)
+                                      it->second->onRegisterSuccess_(it->second->prefix_, hId);
+                              }
+                              self->absorbCovered(reg);
+                          });
+}
+
+void FaceProcessorImpl::absorbCovered(const shared_ptr<NfdRegistration>& cover)
+{
+    // registrations made before the cover would nest under it -- Face calls every matching
+    // filter, so Interests would be dispatched once per nested registration; they are
+    // dropped only now, so that their prefixes stay reachable until the cover is up
+    vector<shared_ptr<NfdRegistration>> covered;
+    for (auto &reg:nfdRegistrations_)
+        if (reg != cover && reg->state_ != NfdRegistration::State::Batched &&
+            cover->prefix_.isPrefixOf(reg->prefix_))
+            covered.push_back(reg);
+    
+    for (auto &reg:covered)
+    {
+        face_->removeRegisteredPrefix(reg->registeredPrefixId_);
+        removeRegistration(reg);
+        
+        for (auto hId:reg->handlers_)
+        {
+            auto it = handlers_.find(hId);
+            if (it == handlers_.end())
+                continue;
+            
+            // handlers of a registered prefix have been notified already
+            if (reg->state_ == NfdRegistration::State::Registered)
+            {
+                it->second->registration_ = cover;
+                cover->handlers_.insert(hId);
             }
+            else
+                attachHandler(it->second, cover);
         }
+        reg->handlers_.clear();
+    }
+}
+
+void FaceProcessorImpl::dispatchInterest(const shared_ptr<const Interest>& interest, Face& face,
+                                         const shared_ptr<const InterestFilter>& filter)
+{
+    const Name& n = interest->getName();
+    TrieNode *node = &trieRoot_, *match = (trieRoot_.handlers_.size() ? &trieRoot_ : nullptr);
+    
+    for (size_t i = 0; i < n.size(); ++i)
+    {
+        auto it = node->children_.find(n.get(i));
+        if (it == node->children_.end())
+            break;
+        node = it->second.get();
+        if (node->handlers_.size())
+            match = node;
+    }
+    
+    if (match)
+    {
+        // handlers may unregister themselves
+        vector<shared_ptr<PrefixHandler>> handlers = match->handlers_;
+        for (auto &h:handlers)
+            h->onInterest_(h->prefix_, interest, face, h->id_, filter);
+    }
+}
+
+void FaceProcessorImpl::trieInsert(const shared_ptr<PrefixHandler>& h)
+{
+    TrieNode *node = &trieRoot_;
+    for (size_t i = 0; i < h->prefix_->size(); ++i)
+    {
+        unique_ptr<TrieNode> &child = node->children_[h->prefix_->get(i)];
+        if (!child)
+            child.reset(new TrieNode());
+        node = child.get();
+    }
+    node->handlers_.push_back(h);
+}
+
+void FaceProcessorImpl::trieRemove(const shared_ptr<PrefixHandler>& h)
+{
+    vector<TrieNode*> path = { &trieRoot_ };
+    for (size_t i = 0; i < h->prefix_->size(); ++i)
+    {
+        auto it = path.back()->children_.find(h->prefix_->get(i));
+        if (it == path.back()->children_.end())
+            return;
+        path.push_back(it->second.get());
+    }
+    
+    vector<shared_ptr<PrefixHandler>> &handlers = path.back()->handlers_;
+    handlers.erase(remove(handlers.begin(), handlers.end(), h), handlers.end());
+    
+    // prune empty branches
+    for (size_t i = path.size() - 1; i > 0; --i)
+    {
+        if (path[i]->handlers_.size() || path[i]->children_.size())
+            break;
+        path[i-1]->children_.erase(h->prefix_->get(i-1));
+    }
+}
+
+//******************************************************************************
+// local pending Interest table
+uint64_t FaceProcessorImpl::expressInterest(const Interest& interest, const OnData& onData,
+                                            const OnTimeout& onTimeout, const OnNetworkNack& onNetworkNack,
+                                            uint64_t pacerId)
+{
+    uint64_t id = ++lastPendingInterestId_;
+    PitConsumer consumer;
+    consumer.interest_ = make_shared<Interest>(interest);
+    consumer.onData_ = onData;
+    consumer.onTimeout_ = onTimeout;
+    consumer.onNetworkNack_ = onNetworkNack;
+    
+    dispatchSynchronized([this, id, consumer, pacerId](shared_ptr<Face>){
+        enqueuePitConsumer(id, consumer, pacerId);
     });
     
-    while (!isRunningFace_) usleep(10000);
+    return id;
+}
+
+void FaceProcessorImpl::removePendingInterest(uint64_t pendingInterestId)
+{
+    dispatchSynchronized([this, pendingInterestId](shared_ptr<Face>){
+        auto it = queuedConsumers_.find(pendingInterestId);
+        if (it != queuedConsumers_.end())
+        {
+            shared_ptr<Pacer> p = getPacer(it->second);
+            if (p) p->nQueued_--;
+            queuedConsumers_.erase(it);
+        }
+        else
+            removePitConsumer(pendingInterestId);
+    });
+}
+
+string FaceProcessorImpl::getPitKey(const Interest& i) const
+{
+    string key = i.getName().toUri();
+    key += (i.getCanBePrefix() ? "|p" : "|-");
+    key += (i.getMustBeFresh() ? "f" : "-");
+    // entry is expressed with the first consumer's Interest, so consumers merge only if they
+    // expire together -- otherwise a retransmission attempt with RTO-sized lifetime would
+    // cut a long-lived Interest short or never make it to the wire itself
+    key += "|" + to_string((int64_t)i.getInterestLifetimeMilliseconds());
+    // consumers get Data fetched with the first consumer's selectors, so those must match too
+    key += "|" + to_string(i.getMinSuffixComponents()) + "," + to_string(i.getMaxSuffixComponents()) +
+        "," + to_string(i.getChildSelector());
+    if (i.getExclude().size())
+        key += "|x" + i.getExclude().toUri();
+    for (size_t k = 0; k < i.getForwardingHint().size(); ++k)
+        key += "|h" + i.getForwardingHint().get(k).getName().toUri();
+    return key;
+}
+
+void FaceProcessorImpl::addPitConsumer(uint64_t id, PitConsumer consumer)
+{
+    string key = getPitKey(*consumer.interest_);
+    
+    auto it = pit_.find(key);
+    if (it != pit_.end())
+    {
+        it->second->consumers_[id] = consumer;
+        pitConsumers_[id] = it->second;
+        nInterestsAggregated_++;
+        return;
+    }
+    
+    shared_ptr<PitEntry> entry = make_shared<PitEntry>();
+    entry->key_ = key;
+    entry->consumers_[id] = consumer;
+    pit_[key] = entry;
+    pitConsumers_[id] = entry;
+    nPitEntries_ = pit_.size();
+    
+    expressPitEntry(entry);
+}
+
+void FaceProcessorImpl::expressPitEntry(const shared_ptr<PitEntry>& entry)
+{
+    weak_ptr<FaceProcessorImpl> me = shared_from_this();
+    nInterestsExpressed_++;
+    entry->pendingInterestId_ =
+    face_->expressInterest(*entry->consumers_.begin()->second.interest_,
+                           [me, entry](const shared_ptr<const Interest>&, const shared_ptr<Data>& d){
+                               shared_ptr<FaceProcessorImpl> self = me.lock();
+                               if (!self) return;
+                               self->onRecoveryConfirmed();
+                               for (auto &c:self->satisfyPitEntry(entry))
+                                   if (c.second.onData_) c.second.onData_(c.second.interest_, d);
+                           },
+                           [me, entry](const shared_ptr<const Interest>&){
+                               shared_ptr<FaceProcessorImpl> self = me.lock();
+                               if (!self) return;
+                               for (auto &c:self->satisfyPitEntry(entry))
+                                   if (c.second.onTimeout_) c.second.onTimeout_(c.second.interest_);
+                           },
+                           [me, entry](const shared_ptr<const Interest>&, const shared_ptr<NetworkNack>& n){
+                               shared_ptr<FaceProcessorImpl> self = me.lock();
+                               if (!self) return;
+                               self->onRecoveryConfirmed();
+                               for (auto &c:self->satisfyPitEntry(entry))
+                                   if (c.second.onNetworkNack_) c.second.onNetworkNack_(c.second.interest_, n);
+                           });
+}
+
+//******************************************************************************
+// Interest pacing
+uint64_t FaceProcessorImpl::addPacer(const PacingOptions& options)
+{
+    uint64_t pacerId = ++lastPacerId_;
+    
+    dispatchSynchronized([this, pacerId, options](shared_ptr<Face>){
+        shared_ptr<Pacer> p = make_shared<Pacer>();
+        p->bucket_.setOptions(options.rate_, options.burst_);
+        
+        lock_guard<mutex> scopedLock(pacersMtx_);
+        pacers_[pacerId] = p;
+    });
+    
+    return pacerId;
+}
+
+void FaceProcessorImpl::setPacer(uint64_t pacerId, const PacingOptions& options)
+{
+    dispatchSynchronized([this, pacerId, options](shared_ptr<Face>){
+        shared_ptr<Pacer> p = getPacer(pacerId);
+        if (p)
+        {
+            p->bucket_.setOptions(options.rate_, options.burst_);
+            drainPacers();
+        }
+    });
+}
+
+void FaceProcessorImpl::removePacer(uint64_t pacerId)
+{
+    if (pacerId == 0)
+        return;
+    
+    dispatchSynchronized([this, pacerId](shared_ptr<Face>){
+        shared_ptr<Pacer> p = getPacer(pacerId);
+        if (!p)
+            return;
+        
+        shared_ptr<Pacer> defaultPacer = getPacer(0);
+        for (auto &q:p->queue_)
+        {
+            auto it = queuedConsumers_.find(q.id_);
+            if (it != queuedConsumers_.end())
+            {
+                it->second = 0;
+                defaultPacer->queue_.push_back(q);
+                defaultPacer->nQueued_++;
+            }
+        }
+        
+        {
+            lock_guard<mutex> scopedLock(pacersMtx_);
+            pacers_.erase(pacerId);
+        }
+        drainPacers();
+    });
+}
+
+size_t FaceProcessorImpl::getPacerQueueSize(uint64_t pacerId) const
+{
+    shared_ptr<Pacer> p = getPacer(pacerId);
+    return p ? p->nQueued_.load() : 0;
+}
+
+uint32_t FaceProcessorImpl::getPacerDelayUs(uint64_t pacerId) const
+{
+    shared_ptr<Pacer> p = getPacer(pacerId);
+    return p ? p->delayAvgUs_.load() : 0;
+}
+
+shared_ptr<FaceProcessorImpl::Pacer> FaceProcessorImpl::getPacer(uint64_t pacerId) const
+{
+    lock_guard<mutex> scopedLock(pacersMtx_);
+    auto it = pacers_.find(pacerId);
+    return (it != pacers_.end() ? it->second : nullptr);
+}
+
+void FaceProcessorImpl::enqueuePitConsumer(uint64_t id, PitConsumer consumer, uint64_t pacerId)
+{
+    // nothing is sent for Interests merged with pending ones, no need to wait
+    if (pit_.find(getPitKey(*consumer.interest_)) != pit_.end())
+    {
+        addPitConsumer(id, consumer);
+        return;
+    }
+    
+    shared_ptr<Pacer> p = getPacer(pacerId);
+    if (!p)
+    {
+        pacerId = 0;
+        p = getPacer(0);
+    }
+    
+    p->queue_.push_back({ id, consumer, std::chrono::steady_clock::now() });
+    p->nQueued_++;
+    queuedConsumers_[id] = pacerId;
+    drainPacers();
+}
+
+void FaceProcessorImpl::drainPacers()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    uint64_t waitUs = 0;
+    vector<pair<uint64_t, shared_ptr<Pacer>>> pacers;
+    {
+        lock_guard<mutex> scopedLock(pacersMtx_);
+        for (auto &it:pacers_)
+            if (it.second->queue_.size())
+                pacers.push_back(it);
+    }
+    
+    lock_guard<mutex> globalLock(detail::GlobalBucketMtx);
+    detail::GlobalBucket.refill(now);
+    for (auto &it:pacers)
+        it.second->bucket_.refill(now);
+    
+    // serve pacers round robin, one Interest per pacer at a time
+    bool sent = true;
+    while (sent)
+    {
+        sent = false;
+        for (auto &it:pacers)
+        {
+            Pacer &p = *it.second;
+            
+            // drop consumers removed while queued
+            while (p.queue_.size() && queuedConsumers_.find(p.queue_.front().id_) == queuedConsumers_.end())
+                p.queue_.pop_front();
+            if (p.queue_.empty())
+                continue;
+            
+            QueuedConsumer &q = p.queue_.front();
+            bool aggregated = (pit_.find(getPitKey(*q.consumer_.interest_)) != pit_.end());
+            
+            if (!aggregated)
+            {
+                if (!p.bucket_.hasTokens() || !detail::GlobalBucket.hasTokens())
+                {
+                    uint64_t w = max(p.bucket_.getWaitUs(), detail::GlobalBucket.getWaitUs());
+                    waitUs = (waitUs ? min(waitUs, w) : w);
+                    continue;
+                }
+                p.bucket_.take();
+                detail::GlobalBucket.take();
+            }
+            
+            uint32_t delayUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - q.enqueueTs_).count();
+            p.delayAvgUs_ = (p.delayAvgUs_ ? (7*p.delayAvgUs_ + delayUs) / 8 : delayUs);
+            
+            QueuedConsumer qc = q;
+            p.queue_.pop_front();
+            p.nQueued_--;
+            queuedConsumers_.erase(qc.id_);
+            addPitConsumer(qc.id_, qc.consumer_);
+            sent = true;
+        }
+    }
+    
+    if (waitUs && !pacingScheduled_)
+    {
+        pacingScheduled_ = true;
+        weak_ptr<FaceProcessorImpl> me = shared_from_this();
+        pacingTimer_.expires_from_now(std::chrono::microseconds(max(waitUs, (uint64_t)PACING_TIMER_MIN_US)));
+        pacingTimer_.async_wait([me](const boost::system::error_code& e){
+            shared_ptr<FaceProcessorImpl> self = me.lock();
+            if (self && e != boost::asio::error::operation_aborted)
+            {
+                self->pacingScheduled_ = false;
+                self->drainPacers();
+            }
+        });
+    }
+}
+
+//******************************************************************************
+// outgoing Data scheduler
+void FaceProcessorImpl::putData(const shared_ptr<const Data>& data, DataPriority priority)
+{
+    // Data is expected to be signed, so wire encoding is already there
+    const Name &n = data->getName();
+    QueuedData qd = { data, (n.size() && n[-1].isSegment() ? n.getPrefix(-1) : n),
+        data->getDefaultWireEncoding().size(), std::chrono::steady_clock::now() };
+    
+    dispatchSynchronized([this, qd, priority](shared_ptr<Face>){
+        int p = (int)priority;
+        if (droppedFrames_[p].size())
+        {
+            // rest of the frame is useless, once some of it was dropped; next frame
+            // clears it, so re-requested packets of the dropped frame go out later
+            if (qd.frame_.equals(droppedFrames_[p]))
+            {
+                nDataDropped_++;
+                return;
+            }
+            droppedFrames_[p] = Name();
+        }
+        
+        dataQueues_[p].push_back(qd);
+        nDataQueued_++;
+        nDataQueuedBytes_ += qd.size_;
+        
+        if (dataQueueLimit_ && nDataQueuedBytes_ > dataQueueLimit_)
+            trimData();
+        
+        drainData();
+    });
+}
+
+void FaceProcessorImpl::trimData()
+{
+    // Deltas go first: these are the cheapest to lose and the ones queued before a pending
+    // keyframe are superseded by it anyway; a keyframe is dropped only if Deltas are gone.
+    // Oldest frames go first within a class
+    static const DataPriority DropOrder[DATA_PRIORITY_NUM] = {
+        DataPriority::Delta, DataPriority::Keyframe,
+        DataPriority::Metadata, DataPriority::Certificate };
+    
+    for (DataPriority priority:DropOrder)
+    {
+        int p = (int)priority;
+        deque<QueuedData> &q = dataQueues_[p];
+        
+        while (q.size() && nDataQueuedBytes_ > dataQueueLimit_)
+        {
+            Name frame = q.front().frame_;
+            bool isSegmented = (frame.size() < q.front().data_->getName().size());
+            while (q.size() && q.front().frame_.equals(frame))
+            {
+                nDataQueuedBytes_ -= q.front().size_;
+                nDataQueued_--;
+                nDataDropped_++;
+                q.pop_front();
+            }
+            droppedFrames_[p] = (isSegmented ? frame : Name());
+        }
+        
+        if (nDataQueuedBytes_ <= dataQueueLimit_)
+            break;
+    }
+}
+
+int FaceProcessorImpl::nextDataQueue(const std::chrono::steady_clock::time_point& now) const
+{
+    // strict priority, except that packets waiting for too long go first (oldest of them),
+    // so lower classes can't be starved by a steady flow of higher priority ones
+    int next = -1, aged = -1;
+    for (int p = 0; p < DATA_PRIORITY_NUM; ++p)
+    {
+        if (dataQueues_[p].empty())
+            continue;
+        
+        const std::chrono::steady_clock::time_point &ts = dataQueues_[p].front().enqueueTs_;
+        if (next < 0)
+            next = p;
+        if (now - ts > std::chrono::milliseconds(DATA_MAX_WAIT_MS) &&
+            (aged < 0 || ts < dataQueues_[aged].front().enqueueTs_))
+            aged = p;
+    }
+    
+    return (aged >= 0 ? aged : next);
+}
+
+void FaceProcessorImpl::setDataShaping(const DataShapingOptions& options)
+{
+    dispatchSynchronized([this, options](shared_ptr<Face>){
+        dataBucket_.setOptions(options.rate_, options.burst_);
+        dataQueueLimit_ = options.queueLimit_;
+        drainData();
+    });
+}
+
+void FaceProcessorImpl::drainData()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    uint64_t waitUs = 0;
+    dataBucket_.refill(now);
+    
+    for (int p = nextDataQueue(now); p >= 0; p = nextDataQueue(now))
+    {
+        deque<QueuedData> &q = dataQueues_[p];
+        QueuedData &qd = q.front();
+        if (!dataBucket_.hasTokens(qd.size_))
+        {
+            // lower priority packets wait too, otherwise small ones would starve large ones
+            waitUs = dataBucket_.getWaitUs(qd.size_);
+            break;
+        }
+        
+        dataBucket_.take(qd.size_);
+        face_->putData(*qd.data_);
+        
+        uint32_t delayUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - qd.enqueueTs_).count();
+        dataDelayAvgUs_ = (dataDelayAvgUs_ ? (7*dataDelayAvgUs_ + delayUs) / 8 : delayUs);
+        nDataQueuedBytes_ -= qd.size_;
+        nDataQueued_--;
+        q.pop_front();
+    }
+    
+    if (waitUs && !dataScheduled_)
+    {
+        dataScheduled_ = true;
+        weak_ptr<FaceProcessorImpl> me = shared_from_this();
+        dataTimer_.expires_from_now(std::chrono::microseconds(max(waitUs, (uint64_t)PACING_TIMER_MIN_US)));
+        dataTimer_.async_wait([me](const boost::system::error_code& e){
+            shared_ptr<FaceProcessorImpl> self = me.lock();
+            if (self && e != boost::asio::error::operation_aborted)
+            {
+                self->dataScheduled_ = false;
+                self->drainData();
+            }
+        });
+    }
+}
+
+void FaceProcessorImpl::removePitConsumer(uint64_t id)
+{
+    auto it = pitConsumers_.find(id);
+    if (it == pitConsumers_.end())
+        return;
+    
+    shared_ptr<PitEntry> entry = it->second;
+    pitConsumers_.erase(it);
+    entry->consumers_.erase(id);
+    
+    if (entry->consumers_.empty())
+    {
+        face_->removePendingInterest(entry->pendingInterestId_);
+        pit_.erase(entry->key_);
+        nPitEntries_ = pit_.size();
+    }
+}
+
+map<uint64_t, FaceProcessorImpl::PitConsumer>
+FaceProcessorImpl::satisfyPitEntry(const shared_ptr<PitEntry>& entry)
+{
+    map<uint64_t, PitConsumer> consumers;
+    swap(consumers, entry->consumers_);
+    
+    for (auto &c:consumers)
+        pitConsumers_.erase(c.first);
+    
+    auto it = pit_.find(entry->key_);
+    if (it != pit_.end() && it->second == entry)
+        pit_.erase(it);
+    nPitEntries_ = pit_.size();
+    
+    return consumers;
 }
@@ -12,6 +12,9 @@
 #define BOOST_BIND_NO_PLACEHOLDERS
 
 #include <stdio.h>
+#include <future>
+#include <memory>
+#include <type_traits>
 #include <boost/asio.hpp>
 #include <boost/signals2/signal.hpp>
 
@@ -20,16 +23,23 @@ namespace ndn {
     class Name;
     class Interest;
     class InterestFilter;
+    class Data;
+    class NetworkNack;
+    class KeyChain;
 }
 
 namespace touch_ndn {
     namespace helpers {
+        struct ThreadOptions;
         
         typedef std::function<void(const std::shared_ptr<ndn::Face>&,
             const std::exception&)> OnFaceReset;
         typedef boost::signals2::signal<void(const std::shared_ptr<ndn::Face>&,
             const std::exception&)> FaceResetEvent;
         typedef boost::signals2::connection FaceResetConnection;
+        typedef std::function<void(const std::shared_ptr<ndn::Face>&)> OnFaceRecovered;
+        typedef boost::signals2::signal<void(const std::shared_ptr<ndn::Face>&)> FaceRecoveredEvent;
+        typedef boost::signals2::connection FaceRecoveredConnection;
         
         typedef std::function<void
         (const std::shared_ptr<const ndn::Name>& prefix,
@@ -44,6 +54,127 @@ namespace touch_ndn {
         (const std::shared_ptr<const ndn::Name>& prefix,
         uint64_t registeredPrefixId)> OnRegisterSuccess;
         
+        typedef std::function<void
+        (const std::shared_ptr<const ndn::Interest>& interest,
+        const std::shared_ptr<ndn::Data>& data)> OnData;
+        
+        typedef std::function<void
+        (const std::shared_ptr<const ndn::Interest>& interest)> OnTimeout;
+        
+        typedef std::function<void
+        (const std::shared_ptr<const ndn::Interest>& interest,
+        const std::shared_ptr<ndn::NetworkNack>& networkNack)> OnNetworkNack;
+        
+        // Outcome of an Interest expressed with FaceProcessor::expressInterestAsync
+        typedef struct _InterestResult {
+            enum class Status {
+                Data,
+                Timeout,
+                Nack
+            };
+            
+            Status status_;
+            std::shared_ptr<const ndn::Interest> interest_;
+            std::shared_ptr<ndn::Data> data_;
+            std::shared_ptr<ndn::NetworkNack> networkNack_;
+        } InterestResult;
+        
+        // Token bucket settings for Interest pacing
+        struct PacingOptions {
+            PacingOptions(): rate_(0), burst_(0) {}
+            
+            // average number of Interests sent per second; zero -- no limit
+            double rate_;
+            // number of Interests that may be sent back to back after an idle period
+            uint32_t burst_;
+        };
+        
+        // Classes of outgoing Data, highest priority first
+        enum class DataPriority : int {
+            Certificate,
+            Metadata,
+            Delta,
+            Keyframe
+        };
+        
+        // Byte-rate shaping settings for outgoing Data
+        struct DataShapingOptions {
+            DataShapingOptions(): rate_(0), burst_(0), queueLimit_(0) {}
+            
+            // average number of bytes sent per second; zero -- no limit
+            double rate_;
+            // number of bytes that may be sent back to back after an idle period
+            uint32_t burst_;
+            // once this many bytes are queued, oldest frames are dropped whole, Deltas first,
+            // then Keyframes, Metadata and Certificates; zero -- no limit
+            uint32_t queueLimit_;
+        };
+        
+        namespace detail {
+            // Free-list of fixed-size memory blocks shared by all threads. Backs completion
+            // objects of the asynchronous FaceProcessor API, so that a steady flow of async
+            // calls doesn't go to the heap. Freed blocks are kept for reuse.
+            class BlockPool {
+            public:
+                static void* allocate(size_t size);
+                static void deallocate(void* p, size_t size);
+            };
+            
+            template<typename T>
+            struct PoolAllocator {
+                typedef T value_type;
+                
+                PoolAllocator() = default;
+                template<typename U> PoolAllocator(const PoolAllocator<U>&) {}
+                
+                T* allocate(size_t n) { return static_cast<T*>(BlockPool::allocate(n*sizeof(T))); }
+                void deallocate(T* p, size_t n) { BlockPool::deallocate(p, n*sizeof(T)); }
+            };
+            
+            template<typename T, typename U>
+            bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+            template<typename T, typename U>
+            bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+            
+            // Promise together with its shared state, both allocated from BlockPool.
+            // If it is destroyed unfulfilled (i.e. block was dropped because processing
+            // has stopped), future receives broken_promise error.
+            template<typename R>
+            struct Completion {
+                Completion() : promise_(std::allocator_arg, PoolAllocator<R>()) {}
+                
+                template<typename F, typename... Args>
+                void run(F& f, Args&&... args)
+                {
+                    try {
+                        promise_.set_value(f(std::forward<Args>(args)...));
+                    } catch (...) {
+                        promise_.set_exception(std::current_exception());
+                    }
+                }
+                
+                std::promise<R> promise_;
+            };
+            
+            template<>
+            template<typename F, typename... Args>
+            void Completion<void>::run(F& f, Args&&... args)
+            {
+                try {
+                    f(std::forward<Args>(args)...);
+                    promise_.set_value();
+                } catch (...) {
+                    promise_.set_exception(std::current_exception());
+                }
+            }
+            
+            template<typename R>
+            std::shared_ptr<Completion<R>> makeCompletion()
+            {
+                return std::allocate_shared<Completion<R>>(PoolAllocator<Completion<R>>());
+            }
+        }
+        
         class FaceProcessorImpl;
         
         /**
@@ -51,9 +182,24 @@ namespace touch_ndn {
          * Internally, it runs a separate processing thread (that calls processEvents).
          * It provides convenient interface for dispatching callbacks on that thread (either
          * synchronously or asynchronously).
+         * If Face fails (i.e. NFD restarts), FaceProcessor creates a new one, retrying with
+         * exponential backoff, then re-registers prefixes of registered handlers and re-expresses
+         * Interests from local pending Interest table. Observers are notified with onFaceReset_
+         * when Face fails and with onFaceRecovered_ once new Face is created (before state is
+         * restored, so that command signing info can be set up first). Both are called on the
+         * processing thread.
          */
         class FaceProcessor {
         public:
+            // How processing thread waits for work:
+            //  - EventDriven: sleeps until a block is dispatched or network data arrives (for
+            //    non-ThreadsafeFace builds, socket is polled with backoff up to 5ms when idle);
+            //  - BusyPoll: never sleeps, trading one CPU core for lowest turnaround.
+            enum class ProcessingMode {
+                EventDriven,
+                BusyPoll
+            };
+            
             FaceProcessor(std::string host);
             ~FaceProcessor();
             
@@ -70,6 +216,20 @@ namespace touch_ndn {
             // in milliseconds
             uint64_t getLastProcessingCallTimestamp() const;
             
+            void setProcessingMode(ProcessingMode mode);
+            ProcessingMode getProcessingMode() const;
+            
+            // Applies name, CPU affinity and priority options to the processing thread
+            void setThreadOptions(const ThreadOptions& options);
+            
+            // Returns CPU time consumed by the processing thread, in microseconds
+            uint64_t getThreadCpuTimeUs();
+            
+            // Returns average (exponentially weighted) and max time between dispatching
+            // a block from another thread and its execution on the processing thread, in microseconds
+            uint32_t getDispatchLatencyAvgUs() const;
+            uint32_t getDispatchLatencyMaxUs() const;
+            
             // Returns io_service for the processing thread.
             //boost::asio::io_service& getIo();
             
@@ -80,10 +240,27 @@ namespace touch_ndn {
             void dispatchSynchronized(std::function<void(std::shared_ptr<ndn::Face>)> dispatchBlock);
             
             // Dispatches code block on the face processing thread and waits till it gets executed,
-            // then returns.
+            // then returns. Exception thrown by the block is rethrown to the caller.
             void performSynchronized(std::function<void(std::shared_ptr<ndn::Face>)> dispatchBlock);
             
-            // Registers prefix on the face. All callbacks will be called on the processing thread.
+            // Dispatches code block on the face processing thread and returns immediately.
+            // Returned future gets block's return value (or exception thrown by it) once it has
+            // been executed. Never blocks the caller, unless it waits on the future.
+            template<typename F,
+                     typename R = typename std::result_of<F(std::shared_ptr<ndn::Face>)>::type>
+            std::future<R> dispatchAsync(F dispatchBlock)
+            {
+                std::shared_ptr<detail::Completion<R>> c = detail::makeCompletion<R>();
+                std::future<R> f = c->promise_.get_future();
+                
+                dispatchSynchronized([c, dispatchBlock](std::shared_ptr<ndn::Face> face) mutable {
+                    c->run(dispatchBlock, face);
+                });
+                return f;
+            }
+            
+            // Registers prefix on the face and returns immediately. All callbacks will be called
+            // on the processing thread.
             void registerPrefix(const ndn::Name& prefix,
                                 const OnInterestCallback& onInterest,
                                 const OnRegisterFailed& onRegisterFailed,
@@ -96,6 +273,126 @@ namespace touch_ndn {
                                         const OnRegisterFailed& onRegisterFailed,
                                         const OnRegisterSuccess& onRegisterSuccess);
             
+            // Registers prefix on the face and returns immediately. Returned future gets registered
+            // prefix id or runtime_error if registration failed.
+            std::future<uint64_t> registerPrefixAsync(const ndn::Name& prefix,
+                                                      const OnInterestCallback& onInterest);
+            
+            // Adds Interest handler for the prefix to the local name trie and returns handler id.
+            // Incoming Interests are dispatched to the handler(s) with the longest matching prefix.
+            // NFD registrations are shared: if prefix falls under aggregate prefix or under a
+            // prefix that is already registered, no new registration is made; otherwise
+            // registration is batched with other handlers added within a short time window.
+            // onRegisterSuccess receives handler id. All callbacks are called on the processing thread.
+            uint64_t registerHandler(const ndn::Name& prefix,
+                                     const OnInterestCallback& onInterest,
+                                     const OnRegisterFailed& onRegisterFailed = OnRegisterFailed(),
+                                     const OnRegisterSuccess& onRegisterSuccess = OnRegisterSuccess());
+            
+            // Removes handler; NFD registration is removed once it has no handlers left.
+            void unregisterHandler(uint64_t handlerId);
+            
+            // Sets prefix that is registered with NFD on behalf of all handlers under it.
+            // Affects handlers registered after this call.
+            void setAggregatePrefix(const ndn::Name& prefix);
+            
+            // Returns number of prefixes registered with NFD (incl. pending)
+            size_t getNfdRegistrationsNum() const;
+            
+            // Returns number of registered handlers
+            size_t getHandlersNum() const;
+            
+            // Expresses Interest through local pending Interest table. If an identical Interest
+            // (same name, CanBePrefix and MustBeFresh) is already in flight, it is not sent again --
+            // callbacks are attached to the pending entry and Data, timeout or nack is fanned out to
+            // all of them. Each callback receives the Interest it was expressed with.
+            // Interests that have to be sent out are paced by the pacer (see addPacer) and by
+            // the global budget; these wait in pacer's queue until both have a token. Interests
+            // merged with pending ones are never delayed.
+            // Returns id for removePendingInterest. Callbacks are called on the processing thread.
+            uint64_t expressInterest(const ndn::Interest& interest,
+                                     const OnData& onData,
+                                     const OnTimeout& onTimeout = OnTimeout(),
+                                     const OnNetworkNack& onNetworkNack = OnNetworkNack(),
+                                     uint64_t pacerId = 0);
+            
+            // Removes callbacks for the Interest (or drops it from pacer's queue); Interest is
+            // removed from the Face once there are no callbacks left for it.
+            void removePendingInterest(uint64_t pendingInterestId);
+            
+            // Adds Interest pacer (token bucket) and returns its id for expressInterest.
+            // Pacers are served round robin, so one busy pacer doesn't hold off the others.
+            // Pacer 0 always exists and is limited by the global budget only.
+            uint64_t addPacer(const PacingOptions& options);
+            void setPacer(uint64_t pacerId, const PacingOptions& options);
+            // Removes pacer; its queued Interests are moved to pacer 0.
+            void removePacer(uint64_t pacerId);
+            
+            // Returns number of Interests waiting in pacer's queue
+            size_t getPacerQueueSize(uint64_t pacerId) const;
+            
+            // Returns average (exponentially weighted) time Interests spend in pacer's queue,
+            // in microseconds
+            uint32_t getPacerDelayUs(uint64_t pacerId) const;
+            
+            // Sets budget shared by all pacers of all FaceProcessors in the process
+            static void setGlobalPacing(const PacingOptions& options);
+
+            // Returns Face for libraries that express Interests on a Face themselves (i.e. CNL
+            // Namespace): its Interests go through expressInterest (local PIT and the pacer),
+            // timers are passed to the face. Consumer-side only -- registering prefixes or
+            // putting Data on it is not supported. Use it on the processing thread and
+            // re-create it along with the face after Face recovery.
+            std::shared_ptr<ndn::Face> makePacingFace(ndn::Face& face, uint64_t pacerId = 0);
+            
+            // Sends Data through outgoing Data scheduler: packets are sent in priority order
+            // (within byte rate budget), so that small latency-critical packets are not stuck
+            // behind large frames; packets queued for too long go ahead, so no class starves.
+            // Can be called from any thread.
+            void putData(const std::shared_ptr<const ndn::Data>& data,
+                         DataPriority priority = DataPriority::Delta);
+            
+            void setDataShaping(const DataShapingOptions& options);
+            
+            // Returns number of packets and bytes waiting in Data scheduler queues
+            size_t getDataQueueSize() const;
+            size_t getDataQueueBytes() const;
+            
+            // Returns average (exponentially weighted) time Data spends in scheduler queues,
+            // in microseconds
+            uint32_t getDataDelayUs() const;
+            
+            // Returns number of packets dropped due to queue limit
+            uint64_t getDataDroppedNum() const;
+            
+            // Same as expressInterest, but delivers outcome through the returned future.
+            std::future<InterestResult> expressInterestAsync(const ndn::Interest& interest);
+            
+            // Returns number of Interests that were merged with already pending ones
+            uint64_t getInterestsAggregatedNum() const;
+            
+            // Returns number of Interests that were sent out
+            uint64_t getInterestsExpressedNum() const;
+            
+            // Returns number of entries in local pending Interest table
+            size_t getPendingInterestsNum() const;
+            
+            // Sets KeyChain for signing prefix registration commands (with its default
+            // certificate) and sets Face for the KeyChain. Settings are re-applied to the Face
+            // re-created after failure. Pass nullptr to clear.
+            void setCommandKeyChain(const std::shared_ptr<ndn::KeyChain>& keyChain);
+            
+            // Returns number of times Face has failed
+            uint64_t getFaceResetsNum() const;
+            
+            // Returns true if Face has failed and is not yet confirmed to be recovered
+            bool isRecovering() const;
+            
+            // Returns time it took to recover after the last Face failure, in milliseconds:
+            // from failure till the first prefix re-registration is confirmed by NFD (or, if
+            // there's nothing to register, till Face state is restored)
+            uint64_t getLastRecoveryTimeMs() const;
+            
             
             // Creates FaceProcessor with a Face connected to local NFD
             static std::shared_ptr<FaceProcessor> forLocalhost();
@@ -104,6 +401,7 @@ namespace touch_ndn {
             static bool checkNfdConnection(std::string host = "localhost");
             
             FaceResetEvent onFaceReset_;
+            FaceRecoveredEvent onFaceRecovered_;
         private:
             std::shared_ptr<FaceProcessorImpl> pimpl_;
         };
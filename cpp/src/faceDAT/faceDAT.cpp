@@ -35,6 +35,7 @@
 #include <ndn-cpp/security/key-chain.hpp>
 
 #include "faceDAT-external.hpp"
+#include "content-hash.hpp"
 #include "face-processor.hpp"
 #include "keyChainDAT.h"
 #include "key-chain-manager.hpp"
@@ -47,6 +48,10 @@
 #define PAR_LIFETIME_LABEL "Interest Lifetime"
 #define PAR_MUSTBEFRESH "Mustbefresh"
 #define PAR_MUSTBEFRESH_LABEL "MustBeFresh"
+#define PAR_RETRANSMIT "Retransmit"
+#define PAR_RETRANSMIT_LABEL "Retransmit"
+#define PAR_MAX_RETRIES "Maxretries"
+#define PAR_MAX_RETRIES_LABEL "Max Retries"
 
 #define PAR_PAGE_OUTPUT "Output"
 #define PAR_OUT_INTEREST "Interest"
@@ -65,6 +70,52 @@
 
 #define PAR_KEYCHAIN_DAT "Keychaindat"
 #define PAR_KEYCHAIN_DAT_LABEL "KeyChain DAT"
+#define PAR_AGGREGATE_PREFIX "Aggregateprefix"
+#define PAR_AGGREGATE_PREFIX_LABEL "Aggregate Prefix"
+#define PAR_PROCESSING_MODE "Processingmode"
+#define PAR_PROCESSING_MODE_LABEL "Processing Mode"
+#define PAR_PROCESSING_EVENTDRIVEN "Eventdriven"
+#define PAR_PROCESSING_EVENTDRIVEN_LABEL "Event-driven"
+#define PAR_PROCESSING_BUSYPOLL "Busypoll"
+#define PAR_PROCESSING_BUSYPOLL_LABEL "Busy Poll"
+
+#define PAR_PAGE_THREADS "Threads"
+#define PAR_FACE_THREAD_CPUS "Facethreadcpus"
+#define PAR_FACE_THREAD_CPUS_LABEL "Face Thread CPUs"
+#define PAR_FACE_THREAD_PRIORITY "Facethreadpriority"
+#define PAR_FACE_THREAD_PRIORITY_LABEL "Face Thread RT Priority"
+#define PAR_FACE_THREAD_NICE "Facethreadnice"
+#define PAR_FACE_THREAD_NICE_LABEL "Face Thread Nice"
+#define PAR_LOG_THREAD_CPUS "Logthreadcpus"
+#define PAR_LOG_THREAD_CPUS_LABEL "Log Thread CPUs"
+
+#define PAR_PAGE_PACING "Pacing"
+#define PAR_PACING_RATE "Pacingrate"
+#define PAR_PACING_RATE_LABEL "Interest Rate (per sec)"
+#define PAR_PACING_BURST "Pacingburst"
+#define PAR_PACING_BURST_LABEL "Interest Burst"
+#define PAR_GLOBAL_PACING_RATE "Globalpacingrate"
+#define PAR_GLOBAL_PACING_RATE_LABEL "Global Interest Rate (per sec)"
+#define PAR_GLOBAL_PACING_BURST "Globalpacingburst"
+#define PAR_GLOBAL_PACING_BURST_LABEL "Global Interest Burst"
+#define PAR_DATA_RATE "Datarate"
+#define PAR_DATA_RATE_LABEL "Data Rate (KB/sec)"
+#define PAR_DATA_BURST "Databurst"
+#define PAR_DATA_BURST_LABEL "Data Burst (KB)"
+#define PAR_DATA_QUEUE_LIMIT "Dataqueuelimit"
+#define PAR_DATA_QUEUE_LIMIT_LABEL "Data Queue Limit (KB)"
+
+// minimal interval between thread CPU usage samples
+#define CPU_SAMPLE_INTERVAL_MS 500
+
+// retransmission timeout bounds and initial value (before any RTT is measured)
+#define RTO_INITIAL_MS 1000
+#define RTO_MIN_MS 200
+#define RTO_MAX_MS 60000
+// clock granularity term of RTO
+#define RTO_G_MS 10
+// timed out requests are retried after a random delay of up to this fraction of RTO
+#define RETX_TIMEOUT_JITTER 0.25
 
 #define INPUT_COLIDX_NAME 0
 #define INPUT_COLIDX_LIFETIME 1
@@ -77,10 +128,36 @@ using namespace touch_ndn;
 
 //******************************************************************************
 // InfoDAT and InfoCHOP labels and indexes
+const map<string, helpers::FaceProcessor::ProcessingMode> ProcessingModeMap = {
+    { PAR_PROCESSING_EVENTDRIVEN, helpers::FaceProcessor::ProcessingMode::EventDriven },
+    { PAR_PROCESSING_BUSYPOLL, helpers::FaceProcessor::ProcessingMode::BusyPoll }
+};
+
 const map<FaceDAT::InfoChopIndex, string> FaceDAT::ChanNames = {
     { FaceDAT::InfoChopIndex::FaceProcessing, "faceProcessing" },
     { FaceDAT::InfoChopIndex::RequestsTableSize, "requestsTableSize" },
-    { FaceDAT::InfoChopIndex::ExpressedNum, "expressedNum" }
+    { FaceDAT::InfoChopIndex::ExpressedNum, "expressedNum" },
+    { FaceDAT::InfoChopIndex::NfdRegistrationsNum, "nfdRegistrationsNum" },
+    { FaceDAT::InfoChopIndex::PrefixHandlersNum, "prefixHandlersNum" },
+    { FaceDAT::InfoChopIndex::PendingInterestsNum, "pendingInterestsNum" },
+    { FaceDAT::InfoChopIndex::InterestsSentNum, "interestsSentNum" },
+    { FaceDAT::InfoChopIndex::InterestsAggregatedNum, "interestsAggregatedNum" },
+    { FaceDAT::InfoChopIndex::DispatchLatencyUs, "dispatchLatencyUs" },
+    { FaceDAT::InfoChopIndex::DispatchLatencyMaxUs, "dispatchLatencyMaxUs" },
+    { FaceDAT::InfoChopIndex::FaceResetsNum, "faceResetsNum" },
+    { FaceDAT::InfoChopIndex::RecoveryTimeMs, "recoveryTimeMs" },
+    { FaceDAT::InfoChopIndex::FaceThreadCpuUsage, "faceThreadCpuUsage" },
+    { FaceDAT::InfoChopIndex::LogThreadCpuUsage, "logThreadCpuUsage" },
+    { FaceDAT::InfoChopIndex::RetransmissionsNum, "retransmissionsNum" },
+    { FaceDAT::InfoChopIndex::RetransmitRecoveredNum, "retransmitRecoveredNum" },
+    { FaceDAT::InfoChopIndex::RetransmitFailedNum, "retransmitFailedNum" },
+    { FaceDAT::InfoChopIndex::RtoMs, "rtoMs" },
+    { FaceDAT::InfoChopIndex::PacingQueueSize, "pacingQueueSize" },
+    { FaceDAT::InfoChopIndex::PacingDelayUs, "pacingDelayUs" },
+    { FaceDAT::InfoChopIndex::DataQueueSize, "dataQueueSize" },
+    { FaceDAT::InfoChopIndex::DataQueueBytes, "dataQueueBytes" },
+    { FaceDAT::InfoChopIndex::DataDelayUs, "dataDelayUs" },
+    { FaceDAT::InfoChopIndex::DataDroppedNum, "dataDroppedNum" }
 };
 
 enum class Outputs : int32_t {
@@ -139,7 +216,23 @@ FaceDAT::FaceDAT(const OP_NodeInfo* info)
 , signingCertRegId_(0)
 , keyChainDat_("")
 , keyChainDatOp_(nullptr)
+, processingMode_(PAR_PROCESSING_EVENTDRIVEN)
+, faceThreadPriority_(0)
+, faceThreadNice_(0)
+, pacingRate_(0)
+, pacingBurst_(32)
+, globalPacingRate_(0)
+, globalPacingBurst_(256)
+, dataRate_(0)
+, dataBurst_(256)
+, dataQueueLimit_(0)
+, faceThreadCpuUs_(0)
+, logThreadCpuUs_(0)
+, faceThreadCpuUsage_(0)
+, logThreadCpuUsage_(0)
+, inputTextHash_(0)
 {
+    requestsTable_->memory_ = trackMemory("requests");
     currentOutputs_ = {PAR_OUT_HEADERS, PAR_OUT_DRD, PAR_OUT_INTEREST, PAR_OUT_DATA_NAME, PAR_OUT_PAYLOAD_SIZE, PAR_OUT_STATUS, PAR_OUT_RAWSTR};
     dispatchOnExecute(bind(&FaceDAT::initFace, this, _1, _2, _3));
     OPLOG_DEBUG("Created FaceDAT");
@@ -160,86 +253,31 @@ FaceDAT::execute(DAT_Output* output, const OP_Inputs* inputs, void* reserved)
 
     if (inputs->getNumInputs() > 0 && faceProcessor_)
     {
-        vector<shared_ptr<Interest>> inputInterests;
-        const OP_DATInput    *cinput = inputs->getInputDAT(0);
-        bool isTable = cinput->isTable;
-
-        if (!isTable) // is Text
-        {
-            // split by newline
-            stringstream ss(cinput->getCell(0, 0));
-            string prefix;
-            while (getline(ss, prefix))
-            {
-                if (prefix.size())
-                {
-                    shared_ptr<Interest> i = make_shared<Interest>(prefix);
-                    i->setInterestLifetimeMilliseconds(lifetime_);
-                    i->setMustBeFresh(mustBeFresh_);
-                    inputInterests.push_back(i);
-                }
-            }
-        }
-        else
-        {
-            int numRows = cinput->numRows;
-            int numCols = cinput->numCols;
-            for (int rowIdx = 0; rowIdx < numRows; ++rowIdx)
-            {
-                string prefix(cinput->getCell(rowIdx, INPUT_COLIDX_NAME));
-                int lifetime = lifetime_;
-                bool mustBeFresh = mustBeFresh_;
-                
-                if (INPUT_COLIDX_LIFETIME < numCols)
-                {
-                    string s = cinput->getCell(rowIdx, INPUT_COLIDX_LIFETIME);
-                    try {
-                        if (s.size()) lifetime = stoi(s);
-                    }
-                    catch (std::exception &e)
-                    {
-                        OPLOG_ERROR("Exception {0}", e.what());
-                    }
-                }
-                
-                if (INPUT_COLIDX_FRESH < numCols)
-                {
-                    string s = cinput->getCell(rowIdx, INPUT_COLIDX_FRESH);
-                    transform(s.begin(), s.end(), s.begin(), ::tolower);
-                    if (s.size()) mustBeFresh = (s == "true" ? true : false);
-                }
-                
-                if (prefix.size())
-                {
-                    shared_ptr<Interest> i = make_shared<Interest>(prefix);
-                    i->setInterestLifetimeMilliseconds(lifetime);
-                    i->setMustBeFresh(mustBeFresh);
-                    inputInterests.push_back(i);
-                }
-            }
-        }
-        
         // check if we need to express new interests
         // cancel all requests and flush table if input has new data or any interest parameter has changed
         bool flushTable = false;
-        requestsTable_->acquire([&inputInterests, &flushTable](RequestsDict &d){
-            for (auto i : inputInterests)
-            {
-                RequestsDict::iterator it = d.find(i->getName().toUri());
-                if (it == d.end())
-                    flushTable = true;
-                else
-                    flushTable = (i->getInterestLifetimeMilliseconds() != it->second.interest_->getInterestLifetimeMilliseconds() ||
-                                  i->getMustBeFresh() != it->second.interest_->getMustBeFresh());
-                if (flushTable)
-                    break;
-            }
-        });
+        if (parseInput(inputs->getInputDAT(0)))
+            requestsTable_->acquire([this, &flushTable](RequestsDict &d){
+                for (auto &r : inputRows_)
+                {
+                    if (!r.interest_)
+                        continue;
+                    
+                    RequestsDict::iterator it = d.find(r.uri_);
+                    if (it == d.end())
+                        flushTable = true;
+                    else
+                        flushTable = (r.interest_->getInterestLifetimeMilliseconds() != it->second.interest_->getInterestLifetimeMilliseconds() ||
+                                      r.interest_->getMustBeFresh() != it->second.interest_->getMustBeFresh());
+                    if (flushTable)
+                        break;
+                }
+            });
         
         if (flushTable || forceExpress_)
         {
             cancelRequests();
-            express(inputInterests, flushTable);
+            express(inputInterests_, flushTable);
         }
     }
     
@@ -250,6 +288,7 @@ FaceDAT::execute(DAT_Output* output, const OP_Inputs* inputs, void* reserved)
 int32_t
 FaceDAT::getNumInfoCHOPChans(void* reserved1)
 {
+    sampleThreadsCpuUsage();
     return BaseDAT::getNumInfoCHOPChans(reserved1) + (int32_t) ChanNames.size();
 }
 
@@ -278,6 +317,111 @@ FaceDAT::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
                 chan->value = nExpressed_;
             }
                 break;
+            case FaceDAT::InfoChopIndex::NfdRegistrationsNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getNfdRegistrationsNum() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::PrefixHandlersNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getHandlersNum() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::PendingInterestsNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getPendingInterestsNum() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::InterestsSentNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getInterestsExpressedNum() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::InterestsAggregatedNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getInterestsAggregatedNum() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::DispatchLatencyUs:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getDispatchLatencyAvgUs() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::DispatchLatencyMaxUs:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getDispatchLatencyMaxUs() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::FaceResetsNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getFaceResetsNum() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::RecoveryTimeMs:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getLastRecoveryTimeMs() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::FaceThreadCpuUsage:
+            {
+                chan->value = faceThreadCpuUsage_;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::LogThreadCpuUsage:
+            {
+                chan->value = logThreadCpuUsage_;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::RetransmissionsNum:
+            {
+                chan->value = requestsTable_->nRetransmitted_;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::RetransmitRecoveredNum:
+            {
+                chan->value = requestsTable_->nRecovered_;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::RetransmitFailedNum:
+            {
+                chan->value = requestsTable_->nFailed_;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::RtoMs:
+            {
+                chan->value = requestsTable_->rto_;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::PacingQueueSize:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getPacerQueueSize(requestsTable_->pacerId_) : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::PacingDelayUs:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getPacerDelayUs(requestsTable_->pacerId_) : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::DataQueueSize:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getDataQueueSize() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::DataQueueBytes:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getDataQueueBytes() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::DataDelayUs:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getDataDelayUs() : 0;
+            }
+                break;
+            case FaceDAT::InfoChopIndex::DataDroppedNum:
+            {
+                chan->value = faceProcessor_ ? faceProcessor_->getDataDroppedNum() : 0;
+            }
+                break;
             default:
             {
                 chan->value = 0;
@@ -372,12 +516,171 @@ FaceDAT::setupParameters(OP_ParameterManager* manager, void* reserved1)
          return manager->appendToggle(p);
      });
     
+    appendPar<OP_NumericParameter>
+    (manager, PAR_RETRANSMIT, PAR_RETRANSMIT_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = requestsTable_->retransmit_;
+         
+         return manager->appendToggle(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_MAX_RETRIES, PAR_MAX_RETRIES_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = requestsTable_->maxRetries_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 16;
+         p.minSliders[0] = 0;
+         p.maxSliders[0] = p.maxValues[0];
+         
+         return manager->appendInt(p);
+     });
+    
     appendPar<OP_StringParameter>
     (manager, PAR_KEYCHAIN_DAT, PAR_KEYCHAIN_DAT_LABEL, PAR_PAGE_DEFAULT,
      [&](OP_StringParameter &p){
          return manager->appendDAT(p);
     });
     
+    appendPar<OP_StringParameter>
+    (manager, PAR_AGGREGATE_PREFIX, PAR_AGGREGATE_PREFIX_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_StringParameter &p){
+         p.defaultValue = aggregatePrefix_.c_str();
+         return manager->appendString(p);
+     });
+    
+#define PAR_PROCESSING_MENU_SIZE 2
+    static const char *processingNames[PAR_PROCESSING_MENU_SIZE] = {
+        PAR_PROCESSING_EVENTDRIVEN,
+        PAR_PROCESSING_BUSYPOLL
+    };
+    static const char *processingLabels[PAR_PROCESSING_MENU_SIZE] = {
+        PAR_PROCESSING_EVENTDRIVEN_LABEL,
+        PAR_PROCESSING_BUSYPOLL_LABEL
+    };
+    
+    appendPar<OP_StringParameter>
+    (manager, PAR_PROCESSING_MODE, PAR_PROCESSING_MODE_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_StringParameter &p){
+         p.defaultValue = processingMode_.c_str();
+         return manager->appendMenu(p, PAR_PROCESSING_MENU_SIZE, processingNames, processingLabels);
+     });
+    
+    // threads page
+    appendPar<OP_StringParameter>
+    (manager, PAR_FACE_THREAD_CPUS, PAR_FACE_THREAD_CPUS_LABEL, PAR_PAGE_THREADS,
+     [&](OP_StringParameter &p){
+         p.defaultValue = faceThreadCpus_.c_str();
+         return manager->appendString(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_FACE_THREAD_PRIORITY, PAR_FACE_THREAD_PRIORITY_LABEL, PAR_PAGE_THREADS,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = faceThreadPriority_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 99;
+         p.minSliders[0] = 0;
+         p.maxSliders[0] = 99;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_FACE_THREAD_NICE, PAR_FACE_THREAD_NICE_LABEL, PAR_PAGE_THREADS,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = faceThreadNice_;
+         p.minValues[0] = -20;
+         p.maxValues[0] = 19;
+         p.minSliders[0] = -20;
+         p.maxSliders[0] = 19;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_StringParameter>
+    (manager, PAR_LOG_THREAD_CPUS, PAR_LOG_THREAD_CPUS_LABEL, PAR_PAGE_THREADS,
+     [&](OP_StringParameter &p){
+         p.defaultValue = logThreadCpus_.c_str();
+         return manager->appendString(p);
+     });
+    
+    // pacing page
+    appendPar<OP_NumericParameter>
+    (manager, PAR_PACING_RATE, PAR_PACING_RATE_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = pacingRate_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 100000;
+         p.minSliders[0] = 0;
+         p.maxSliders[0] = 10000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_PACING_BURST, PAR_PACING_BURST_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = pacingBurst_;
+         p.minValues[0] = 1;
+         p.maxValues[0] = 10000;
+         p.minSliders[0] = 1;
+         p.maxSliders[0] = 1000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_GLOBAL_PACING_RATE, PAR_GLOBAL_PACING_RATE_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = globalPacingRate_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 100000;
+         p.minSliders[0] = 0;
+         p.maxSliders[0] = 10000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_GLOBAL_PACING_BURST, PAR_GLOBAL_PACING_BURST_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = globalPacingBurst_;
+         p.minValues[0] = 1;
+         p.maxValues[0] = 10000;
+         p.minSliders[0] = 1;
+         p.maxSliders[0] = 1000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_DATA_RATE, PAR_DATA_RATE_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = dataRate_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 1000000;
+         p.minSliders[0] = 0;
+         p.maxSliders[0] = 100000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_DATA_BURST, PAR_DATA_BURST_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = dataBurst_;
+         p.minValues[0] = 1;
+         p.maxValues[0] = 100000;
+         p.minSliders[0] = 1;
+         p.maxSliders[0] = 10000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_DATA_QUEUE_LIMIT, PAR_DATA_QUEUE_LIMIT_LABEL, PAR_PAGE_PACING,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = dataQueueLimit_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 1000000;
+         p.minSliders[0] = 0;
+         p.maxSliders[0] = 100000;
+         return manager->appendInt(p);
+     });
+    
     // outputs page
     for (auto p : OutputLabels)
         
@@ -416,7 +719,11 @@ FaceDAT::initFace(DAT_Output*output, const OP_Inputs* inputs, void* reserved)
     
     
     // notify existing listeners about reset so that they can react accordingly
-    if (faceProcessor_) notifyListeners(OP_EVENT_RESET);
+    if (faceProcessor_)
+    {
+        notifyListeners(OP_EVENT_RESET);
+        faceProcessor_->removePacer(requestsTable_->pacerId_);
+    }
     faceProcessor_.reset();
     
     try
@@ -426,6 +733,12 @@ FaceDAT::initFace(DAT_Output*output, const OP_Inputs* inputs, void* reserved)
         {
             clearError();
             faceProcessor_ = make_shared<helpers::FaceProcessor>(hostname);
+            faceProcessor_->setAggregatePrefix(Name(aggregatePrefix_));
+            faceProcessor_->setProcessingMode(ProcessingModeMap.at(processingMode_));
+            applyFaceThreadOptions();
+            requestsTable_->pacerId_ = faceProcessor_->addPacer(helpers::PacingOptions());
+            applyPacing();
+            applyDataShaping();
             setIsReady(true);
         }
         else
@@ -438,12 +751,98 @@ FaceDAT::initFace(DAT_Output*output, const OP_Inputs* inputs, void* reserved)
     }
 }
 
+void
+FaceDAT::applyFaceThreadOptions()
+{
+    if (!faceProcessor_)
+        return;
+    
+    helpers::ThreadOptions o;
+    o.cpus_ = helpers::parseCpuList(faceThreadCpus_);
+    o.realtimePriority_ = faceThreadPriority_;
+    o.nice_ = faceThreadNice_;
+    faceProcessor_->setThreadOptions(o);
+}
+
+void
+FaceDAT::applyPacing()
+{
+    if (!faceProcessor_)
+        return;
+    
+    helpers::PacingOptions o;
+    o.rate_ = pacingRate_;
+    o.burst_ = pacingBurst_;
+    faceProcessor_->setPacer(requestsTable_->pacerId_, o);
+}
+
+void
+FaceDAT::applyDataShaping()
+{
+    if (!faceProcessor_)
+        return;
+    
+    helpers::DataShapingOptions o;
+    o.rate_ = 1024. * dataRate_;
+    o.burst_ = 1024 * dataBurst_;
+    o.queueLimit_ = 1024 * dataQueueLimit_;
+    faceProcessor_->setDataShaping(o);
+}
+
+void
+FaceDAT::sampleThreadsCpuUsage()
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    int64_t elapsedUs = chrono::duration_cast<chrono::microseconds>(now - cpuSampleTs_).count();
+    
+    if (elapsedUs < CPU_SAMPLE_INTERVAL_MS*1000)
+        return;
+    
+    uint64_t faceThreadCpuUs = (faceProcessor_ ? faceProcessor_->getThreadCpuTimeUs() : 0);
+    uint64_t logThreadCpuUs = helpers::getLogThreadCpuTimeUs();
+    
+    // counters start over when threads are re-created
+    faceThreadCpuUsage_ = (faceThreadCpuUs >= faceThreadCpuUs_ ?
+                           100. * (faceThreadCpuUs - faceThreadCpuUs_) / elapsedUs : 0);
+    logThreadCpuUsage_ = (logThreadCpuUs >= logThreadCpuUs_ ?
+                          100. * (logThreadCpuUs - logThreadCpuUs_) / elapsedUs : 0);
+    faceThreadCpuUs_ = faceThreadCpuUs;
+    logThreadCpuUs_ = logThreadCpuUs;
+    cpuSampleTs_ = now;
+}
+
 void
 FaceDAT::checkParams(DAT_Output *, const OP_Inputs *inputs,
                      void *reserved)
 {
     updateIfNew<string>
     (PAR_NFD_HOST, nfdHost_, inputs->getParString(PAR_NFD_HOST));
+    updateIfNew<string>
+    (PAR_AGGREGATE_PREFIX, aggregatePrefix_, inputs->getParString(PAR_AGGREGATE_PREFIX));
+    updateIfNew<string>
+    (PAR_PROCESSING_MODE, processingMode_, inputs->getParString(PAR_PROCESSING_MODE));
+    updateIfNew<string>
+    (PAR_FACE_THREAD_CPUS, faceThreadCpus_, inputs->getParString(PAR_FACE_THREAD_CPUS));
+    updateIfNew<int32_t>
+    (PAR_FACE_THREAD_PRIORITY, faceThreadPriority_, inputs->getParInt(PAR_FACE_THREAD_PRIORITY));
+    updateIfNew<int32_t>
+    (PAR_FACE_THREAD_NICE, faceThreadNice_, inputs->getParInt(PAR_FACE_THREAD_NICE));
+    updateIfNew<string>
+    (PAR_LOG_THREAD_CPUS, logThreadCpus_, inputs->getParString(PAR_LOG_THREAD_CPUS));
+    updateIfNew<int32_t>
+    (PAR_PACING_RATE, pacingRate_, inputs->getParInt(PAR_PACING_RATE));
+    updateIfNew<int32_t>
+    (PAR_PACING_BURST, pacingBurst_, inputs->getParInt(PAR_PACING_BURST));
+    updateIfNew<int32_t>
+    (PAR_GLOBAL_PACING_RATE, globalPacingRate_, inputs->getParInt(PAR_GLOBAL_PACING_RATE));
+    updateIfNew<int32_t>
+    (PAR_GLOBAL_PACING_BURST, globalPacingBurst_, inputs->getParInt(PAR_GLOBAL_PACING_BURST));
+    updateIfNew<int32_t>
+    (PAR_DATA_RATE, dataRate_, inputs->getParInt(PAR_DATA_RATE));
+    updateIfNew<int32_t>
+    (PAR_DATA_BURST, dataBurst_, inputs->getParInt(PAR_DATA_BURST));
+    updateIfNew<int32_t>
+    (PAR_DATA_QUEUE_LIMIT, dataQueueLimit_, inputs->getParInt(PAR_DATA_QUEUE_LIMIT));
     
     if (faceProcessor_)
     {
@@ -470,6 +869,8 @@ FaceDAT::checkParams(DAT_Output *, const OP_Inputs *inputs,
     showRawStr_ = inputs->getParInt(PAR_OUT_RAWSTR);
     lifetime_ = inputs->getParInt(PAR_LIFETIME);
     mustBeFresh_ = inputs->getParInt(PAR_MUSTBEFRESH);
+    requestsTable_->retransmit_ = inputs->getParInt(PAR_RETRANSMIT);
+    requestsTable_->maxRetries_ = inputs->getParInt(PAR_MAX_RETRIES);
 }
 
 void
@@ -478,6 +879,33 @@ FaceDAT::paramsUpdated()
     runIfUpdated(PAR_NFD_HOST, [this](){
         dispatchOnExecute(bind(&FaceDAT::initFace, this, _1, _2, _3));
     });
+    runIfUpdated(PAR_AGGREGATE_PREFIX, [this](){
+        // applies to prefixes registered from now on
+        if (faceProcessor_)
+            faceProcessor_->setAggregatePrefix(Name(aggregatePrefix_));
+    });
+    runIfUpdated(PAR_PROCESSING_MODE, [this](){
+        if (faceProcessor_)
+            faceProcessor_->setProcessingMode(ProcessingModeMap.at(processingMode_));
+    });
+    runIfUpdated(PAR_FACE_THREAD_CPUS, [this](){ applyFaceThreadOptions(); });
+    runIfUpdated(PAR_FACE_THREAD_PRIORITY, [this](){ applyFaceThreadOptions(); });
+    runIfUpdated(PAR_FACE_THREAD_NICE, [this](){ applyFaceThreadOptions(); });
+    runIfUpdated(PAR_LOG_THREAD_CPUS, [this](){
+        // log thread is shared by all operators, last update wins
+        helpers::ThreadOptions o;
+        o.cpus_ = helpers::parseCpuList(logThreadCpus_);
+        helpers::setLogThreadOptions(o);
+    });
+    runIfUpdatedAny({PAR_PACING_RATE, PAR_PACING_BURST}, [this](){ applyPacing(); });
+    runIfUpdatedAny({PAR_DATA_RATE, PAR_DATA_BURST, PAR_DATA_QUEUE_LIMIT}, [this](){ applyDataShaping(); });
+    runIfUpdatedAny({PAR_GLOBAL_PACING_RATE, PAR_GLOBAL_PACING_BURST}, [this](){
+        // global budget is shared by all operators, last update wins
+        helpers::PacingOptions o;
+        o.rate_ = globalPacingRate_;
+        o.burst_ = globalPacingBurst_;
+        helpers::FaceProcessor::setGlobalPacing(o);
+    });
     runIfUpdated(PAR_KEYCHAIN_DAT, [this](){
         // clear up existing keychain, if set up
         if (keyChainDatOp_)
@@ -486,6 +914,113 @@ FaceDAT::paramsUpdated()
     });
 }
 
+bool
+FaceDAT::parseInput(const OP_DATInput *input)
+{
+    // default lifetime and freshness are mixed into row hashes, so that all rows are
+    // re-parsed when those change
+    uint64_t seed = ((uint64_t)(uint32_t)lifetime_ << 1) | (uint64_t)mustBeFresh_;
+    size_t nRows = 0;
+    bool changed = false;
+    
+    if (!input->isTable) // is Text
+    {
+        const char *text = input->getCell(0, 0);
+        uint64_t textHash = contentHash(text, strlen(text), seed);
+        if (textHash == inputTextHash_)
+            return false;
+        inputTextHash_ = textHash;
+        
+        // split by newline
+        stringstream ss(text);
+        string prefix;
+        while (getline(ss, prefix))
+        {
+            if (prefix.size())
+                changed |= parseInputRow(nRows++, seed, prefix.data(), prefix.size(), nullptr, nullptr);
+        }
+    }
+    else
+    {
+        inputTextHash_ = 0;
+        for (int rowIdx = 0; rowIdx < input->numRows; ++rowIdx)
+        {
+            const char *name = input->getCell(rowIdx, INPUT_COLIDX_NAME);
+            changed |= parseInputRow(nRows++, seed, name, strlen(name),
+                                     INPUT_COLIDX_LIFETIME < input->numCols ? input->getCell(rowIdx, INPUT_COLIDX_LIFETIME) : nullptr,
+                                     INPUT_COLIDX_FRESH < input->numCols ? input->getCell(rowIdx, INPUT_COLIDX_FRESH) : nullptr);
+        }
+    }
+    
+    if (inputRows_.size() != nRows)
+    {
+        inputRows_.resize(nRows);
+        changed = true;
+    }
+    
+    if (changed)
+    {
+        inputInterests_.clear();
+        for (auto &r : inputRows_)
+            if (r.interest_)
+                inputInterests_.push_back(r.interest_);
+    }
+    
+    return changed;
+}
+
+bool
+FaceDAT::parseInputRow(size_t rowIdx, uint64_t seed, const char *name, size_t nameLen,
+                       const char *lifetimeStr, const char *freshStr)
+{
+    uint64_t hash = contentHash(name, nameLen, seed);
+    if (lifetimeStr) hash = contentHash(lifetimeStr, strlen(lifetimeStr), hash);
+    if (freshStr) hash = contentHash(freshStr, strlen(freshStr), hash);
+    
+    if (rowIdx < inputRows_.size() && inputRows_[rowIdx].hash_ == hash)
+        return false;
+    
+    if (rowIdx >= inputRows_.size())
+        inputRows_.resize(rowIdx+1);
+    
+    InputRow &r = inputRows_[rowIdx];
+    r.hash_ = hash;
+    r.interest_.reset();
+    r.uri_.clear();
+    
+    int lifetime = lifetime_;
+    bool mustBeFresh = mustBeFresh_;
+    
+    if (lifetimeStr)
+    {
+        string s(lifetimeStr);
+        try {
+            if (s.size()) lifetime = stoi(s);
+        }
+        catch (std::exception &e)
+        {
+            OPLOG_ERROR("Exception {0}", e.what());
+        }
+    }
+    
+    if (freshStr)
+    {
+        string s(freshStr);
+        transform(s.begin(), s.end(), s.begin(), ::tolower);
+        if (s.size()) mustBeFresh = (s == "true" ? true : false);
+    }
+    
+    if (nameLen)
+    {
+        r.interest_ = make_shared<Interest>(Name(string(name, nameLen)));
+        r.interest_->setInterestLifetimeMilliseconds(lifetime);
+        r.interest_->setMustBeFresh(mustBeFresh);
+        r.uri_ = r.interest_->getName().toUri();
+    }
+    
+    return true;
+}
+
 void
 FaceDAT::express(const vector<shared_ptr<Interest>>& interests, bool clearTable)
 {
@@ -511,42 +1046,97 @@ FaceDAT::express(shared_ptr<Interest> &i, bool clearTable)
     shared_ptr<RequestsTable> rt = requestsTable_;
     shared_ptr<helpers::logger> logger = logger_;
     nExpressed_++;
-    faceProcessor_->dispatchSynchronized([i, rt, clearTable, logger](shared_ptr<Face> f){
+    helpers::FaceProcessor *fp = faceProcessor_.get();
+    faceProcessor_->dispatchSynchronized([i, rt, clearTable, logger, fp](shared_ptr<Face> f){
         if (clearTable)
             rt->acquire([](RequestsDict &d){
                 d.clear();
             });
 
-        // NOTE: callbacks are called on Face thread!
-        rt->cancelIfPending(*i, *f);
-        uint64_t piId = f->expressInterest(*i,
-                           [rt,logger](const shared_ptr<const Interest>& i, const shared_ptr<Data>& d){
-                               rt->setData(i, d);
-                               logger->trace("Received data {0}", d->getName().toUri());
-                           },
-                           [rt,logger](const shared_ptr<const Interest>& i){
-                               rt->setTimeout(i);
-                               logger->trace("Timeout {}", i->getName().toUri());
-                           },
-                           [rt,logger](const shared_ptr<const Interest>& i, const shared_ptr<NetworkNack>& nack){
-                               rt->setNack(i, nack);
-                               logger->trace("Nack {}", i->getName().toUri());
-                           });
+        // identical Interests from other ops on this face are merged by FaceProcessor
+        rt->cancelIfPending(*i, *fp);
+        uint64_t piId = sendRequest(rt, fp, logger, i, 0);
         assert(rt->setExpressed(i, piId));
     });
 }
 
+uint64_t
+FaceDAT::sendRequest(shared_ptr<RequestsTable> rt, helpers::FaceProcessor *fp,
+                     shared_ptr<helpers::logger> logger, const shared_ptr<const Interest> &i,
+                     uint32_t nRetries)
+{
+    // with retransmissions on, each attempt lives for (backed off) RTO only, so that
+    // losses are detected without waiting for the full Interest lifetime
+    const Interest *attempt = i.get();
+    Interest copy;
+    int lifetime = rt->getAttemptLifetime(*i, nRetries);
+    if (lifetime != i->getInterestLifetimeMilliseconds())
+    {
+        copy = *i;
+        copy.setInterestLifetimeMilliseconds(lifetime);
+        attempt = &copy;
+    }
+    
+    // NOTE: callbacks are called on Face thread!
+    return fp->expressInterest(*attempt,
+                               [rt,logger](const shared_ptr<const Interest>& i, const shared_ptr<Data>& d){
+                                   rt->setData(i, d);
+                                   logger->trace("Received data {0}", d->getName().toUri());
+                               },
+                               [rt,logger,fp](const shared_ptr<const Interest>& i){
+                                   if (retransmit(rt, fp, logger, i, false))
+                                       return;
+                                   rt->setTimeout(i);
+                                   logger->trace("Timeout {}", i->getName().toUri());
+                               },
+                               [rt,logger,fp](const shared_ptr<const Interest>& i, const shared_ptr<NetworkNack>& nack){
+                                   if (retransmit(rt, fp, logger, i, true))
+                                       return;
+                                   rt->setNack(i, nack);
+                                   logger->trace("Nack {}", i->getName().toUri());
+                               },
+                               rt->pacerId_);
+}
+
+bool
+FaceDAT::retransmit(shared_ptr<RequestsTable> rt, helpers::FaceProcessor *fp,
+                    shared_ptr<helpers::logger> logger, const shared_ptr<const Interest> &i,
+                    bool isNack)
+{
+    uint32_t delayMs;
+    uint64_t seq;
+    if (!rt->checkRetransmit(*i, isNack, delayMs, seq))
+        return false;
+    
+    logger->trace("Retransmitting {0} in {1}ms", i->getName().toUri(), delayMs);
+    fp->dispatchSynchronized([rt, fp, logger, i, delayMs, seq](shared_ptr<Face> f){
+        f->callLater(delayMs, [rt, fp, logger, i, seq](){
+            // entry may have been canceled or re-expressed meanwhile
+            rt->acquireIfExists(*i, [&](RequestsDict &d, RequestsDict::iterator &it){
+                if (it->second.seq_ != seq || it->second.isCanceled_)
+                    return;
+                
+                it->second.pitId_ = sendRequest(rt, fp, logger, it->second.interest_,
+                                                it->second.nRetries_);
+                rt->nRetransmitted_++;
+            });
+        });
+    });
+    return true;
+}
+
 void
 FaceDAT::cancelRequests()
 {
     // cancel all pending requests and quit
     shared_ptr<helpers::logger> logger = logger_;
     shared_ptr<RequestsTable> rt = requestsTable_;
-    if (faceProcessor_) faceProcessor_->dispatchSynchronized([rt,logger](shared_ptr<Face> f){
+    helpers::FaceProcessor *fp = faceProcessor_.get();
+    if (faceProcessor_) faceProcessor_->dispatchSynchronized([rt,logger,fp](shared_ptr<Face> f){
             rt->acquire([&](RequestsDict &d){
-                for (auto it : d)
+                for (auto &it : d)
                 {
-                    f->removePendingInterest(it.second.pitId_);
+                    fp->removePendingInterest(it.second.pitId_);
                     it.second.isCanceled_ = true;
                     logger->trace("Canceled pending {0}", it.first);
                 }
@@ -578,7 +1168,7 @@ FaceDAT::outputRequestsTable(DAT_Output *output)
         }
         
         requestsTable_->acquire([output, &rowIdx, this](RequestsDict &d){
-            for (auto p : d)
+            for (auto &p : d)
                 setOutputEntry(output, p, rowIdx++);
         });
     }
@@ -591,6 +1181,7 @@ FaceDAT::outputRequestsTable(DAT_Output *output)
 
 void FaceDAT::setOutputEntry(DAT_Output *output, RequestsDictPair &p, int row)
 {
+    const DataFields *fields = p.second.dataFields_.get();
     int colIdx = 0;
     for (auto l : OutputsMap)
     {
@@ -601,12 +1192,8 @@ void FaceDAT::setOutputEntry(DAT_Output *output, RequestsDictPair &p, int row)
                     output->setCellString(row, colIdx, p.first.c_str());
                     break;
                 case Outputs::DataName:
-                    if (p.second.data_)
-                    {
-                        Name n = (showFullName_ ? *(p.second.data_->getFullName()) : p.second.data_->getName());
-                        
-                        output->setCellString(row, colIdx, n.toUri().c_str());
-                    }
+                    if (fields)
+                        output->setCellString(row, colIdx, (showFullName_ ? fields->fullName_ : fields->name_).c_str());
                     else
                         output->setCellString(row, colIdx, "");
                     break;
@@ -619,32 +1206,19 @@ void FaceDAT::setOutputEntry(DAT_Output *output, RequestsDictPair &p, int row)
                 }
                     break;
                 case Outputs::PayloadSize:
-                    output->setCellInt(row, colIdx,
-                                       p.second.data_ ? (int32_t)p.second.data_->getContent().size() : 0);
+                    output->setCellInt(row, colIdx, fields ? fields->payloadSize_ : 0);
                     break;
                 case Outputs::DataSize:
-                    output->setCellInt(row, colIdx,
-                                       p.second.data_ ? (int32_t)p.second.data_->getDefaultWireEncoding().size() : 0);
+                    output->setCellInt(row, colIdx, fields ? fields->dataSize_ : 0);
                     break;
                 case Outputs::Freshness:
-                    output->setCellInt(row, colIdx,
-                                       p.second.data_ ? (int32_t)p.second.data_->getMetaInfo().getFreshnessPeriod() : 0);
+                    output->setCellInt(row, colIdx, fields ? fields->freshness_ : 0);
                     break;
                 case Outputs::Keylocator:
-                    if (p.second.data_)
-                    {
-                        Name n = KeyLocator::getFromSignature(p.second.data_->getSignature()).getKeyName();
-                        output->setCellString(row, colIdx, n.toUri().c_str());
-                    }
-                    else
-                        output->setCellString(row, colIdx, "");
+                    output->setCellString(row, colIdx, fields ? fields->keyLocator_.c_str() : "");
                     break;
                 case Outputs::Signature:
-                    if (p.second.data_)
-                        output->setCellString(row, colIdx,
-                                              BaseDAT::toBase64(p.second.data_->getSignature()->getSignature()).c_str());
-                    else
-                        output->setCellString(row, colIdx, "");
+                    output->setCellString(row, colIdx, fields ? fields->signature_.c_str() : "");
                     break;
                 case Outputs::Drd:
                     output->setCellInt(row, colIdx, p.second.getDrd());
@@ -659,8 +1233,10 @@ void FaceDAT::setOutputEntry(DAT_Output *output, RequestsDictPair &p, int row)
     if (p.second.data_)
     {
         if (!showRawStr_)
-            output->setCellString(row, colIdx,
-                                  BaseDAT::toBase64(p.second.data_->getContent()).c_str());
+        {
+            BaseDAT::toBase64(p.second.data_->getContent(), base64Buffer_);
+            output->setCellString(row, colIdx, base64Buffer_.c_str());
+        }
         else
             output->setCellString(row, colIdx,
                                   p.second.data_->getContent().toRawStr().c_str());
@@ -700,10 +1276,8 @@ void FaceDAT::setupKeyChainPairing(DAT_Output* output, const OP_Inputs* inputs,
                 shared_ptr<helpers::KeyChainManager> kcm = keyChainDatOp_->getKeyChainManager();
                 // set command signging info
                 // TODO: is it safe to capture this here?
+                faceProcessor_->setCommandKeyChain(kcm->instanceKeyChain());
                 faceProcessor_->dispatchSynchronized([kcm, this](shared_ptr<Face> face){
-                    face->setCommandSigningInfo(*kcm->instanceKeyChain(),
-                                                kcm->instanceKeyChain()->getDefaultCertificateName());
-                    kcm->instanceKeyChain()->setFace(face.get());
                     registerCertPrefixes(face, kcm);
                 });
             }
@@ -719,19 +1293,16 @@ void FaceDAT::clearKeyChainPairing(DAT_Output *, const OP_Inputs *, void *reserv
     {
         OPLOG_DEBUG("Clear KeyChainDAT");
         
-        shared_ptr<helpers::KeyChainManager> kcm = keyChainDatOp_->getKeyChainManager();
         uint64_t signingCertRegId = signingCertRegId_;
         uint64_t instanceCertRegId = instanceCertRegId_;
-        faceProcessor_->dispatchSynchronized([signingCertRegId, instanceCertRegId, kcm](shared_ptr<Face> face){
-            face->removeRegisteredPrefix(signingCertRegId);
+        helpers::FaceProcessor *fp = faceProcessor_.get();
+        faceProcessor_->dispatchSynchronized([signingCertRegId, instanceCertRegId, fp](shared_ptr<Face> face){
+            fp->unregisterHandler(signingCertRegId);
             if (instanceCertRegId != signingCertRegId)
-                face->removeRegisteredPrefix(instanceCertRegId);
-
-            // clear KeyChain's Face
-            kcm->instanceKeyChain()->setFace(nullptr);
-            // clear Face's keychain
-            face->setCommandSigningInfo(*(KeyChain*)0, Name());
+                fp->unregisterHandler(instanceCertRegId);
         });
+        // clears both KeyChain's Face and Face's KeyChain
+        faceProcessor_->setCommandKeyChain(nullptr);
         
         registeredPrefixes_.erase(signingCertRegId_);
         registeredPrefixes_.erase(instanceCertRegId_);
@@ -747,16 +1318,17 @@ void FaceDAT::registerCertPrefixes(std::shared_ptr<ndn::Face> face, std::shared_
 {
     shared_ptr<Data> signingCert = kcm->signingIdentityCertificate();
     shared_ptr<Data> instanceCert = kcm->instanceCertificate();
-    OnInterestCallback onCertInterest = [signingCert, instanceCert]
+    helpers::FaceProcessor *fp = faceProcessor_.get();
+    OnInterestCallback onCertInterest = [signingCert, instanceCert, fp]
             (const shared_ptr<const Name>&,
              const shared_ptr<const Interest> &i,
              Face& f, uint64_t,
              const shared_ptr<const InterestFilter>&)
             {
                 if (i->getName().match(signingCert->getName()))
-                    f.putData(*signingCert);
+                    fp->putData(signingCert, helpers::DataPriority::Certificate);
                 if (i->getName().match(instanceCert->getName()))
-                    f.putData(*instanceCert);
+                    fp->putData(instanceCert, helpers::DataPriority::Certificate);
             };
     OnRegisterFailed onRegisterFailed = [this](const shared_ptr<const Name>& n){
         this->setError("Failed to register prefix: %s", n->toUri().c_str());
@@ -768,12 +1340,14 @@ void FaceDAT::registerCertPrefixes(std::shared_ptr<ndn::Face> face, std::shared_
     };
     
     OPLOG_DEBUG("Registering prefix {}...", signingCert->getName().toUri());
-    signingCertRegId_ = face->registerPrefix(signingCert->getName(), onCertInterest, onRegisterFailed, onRegisterSuccess);
+    signingCertRegId_ = faceProcessor_->registerHandler(signingCert->getName(), onCertInterest,
+                                                        onRegisterFailed, onRegisterSuccess);
     
     if (!signingCert->getName().isPrefixOf(instanceCert->getName()))
     {
         OPLOG_DEBUG("Registering prefix {}...", instanceCert->getName().toUri());
-        instanceCertRegId_ = face->registerPrefix(instanceCert->getName(), onCertInterest, onRegisterFailed, onRegisterSuccess);
+        instanceCertRegId_ = faceProcessor_->registerHandler(instanceCert->getName(), onCertInterest,
+                                                             onRegisterFailed, onRegisterSuccess);
     }
     else
         instanceCertRegId_ = signingCertRegId_;
@@ -782,10 +1356,12 @@ void FaceDAT::registerCertPrefixes(std::shared_ptr<ndn::Face> face, std::shared_
 void FaceDAT::doCleanup()
 {
     // remove all registered prefixes
-    for (auto it:registeredPrefixes_)
-        faceProcessor_->dispatchSynchronized([it](shared_ptr<Face> face){
-            face->removeRegisteredPrefix(it.first);
-        });
+    if (faceProcessor_)
+    {
+        for (auto it:registeredPrefixes_)
+            faceProcessor_->unregisterHandler(it.first);
+        faceProcessor_->removePacer(requestsTable_->pacerId_);
+    }
     // unregister from KeyChainDAT
     if (keyChainDatOp_)
         keyChainDatOp_->unsubscribe(this);
@@ -802,6 +1378,22 @@ void FaceDAT::onOpUpdate(OP_Common *op, const std::string& event)
 }
 
 //******************************************************************************
+FaceDAT::RequestsTable::_RequestsTable()
+: retransmit_(false)
+, maxRetries_(3)
+, nRetransmitted_(0)
+, nRecovered_(0)
+, nFailed_(0)
+, pacerId_(0)
+, hasRttSample_(false)
+, srtt_(0)
+, rttvar_(0)
+, rto_(RTO_INITIAL_MS)
+, lastSeq_(0)
+, rng_(random_device()())
+{
+}
+
 void FaceDAT::RequestsTable::acquireIfExists(const Interest &i, std::function<void (RequestsDict &, RequestsDict::iterator &it)> f)
 {
     lock_guard<recursive_mutex> scopedLock(mx_);
@@ -809,12 +1401,12 @@ void FaceDAT::RequestsTable::acquireIfExists(const Interest &i, std::function<vo
     if (it != dict_.end()) f(dict_, it);
 }
 
-bool FaceDAT::RequestsTable::cancelIfPending(const ndn::Interest &i, ndn::Face &f)
+bool FaceDAT::RequestsTable::cancelIfPending(const ndn::Interest &i, helpers::FaceProcessor &fp)
 {
     bool res = false;
     
     acquireIfExists(i,[&](RequestsDict &d, RequestsDict::iterator &it){
-        f.removePendingInterest(it->second.pitId_);
+        fp.removePendingInterest(it->second.pitId_);
         d.erase(it);
         res = true;
     });
@@ -832,6 +1424,7 @@ bool FaceDAT::RequestsTable::setExpressed(const std::shared_ptr<const ndn::Inter
             RequestStatus rs;
             rs.interest_ = i;
             rs.pitId_ = id;
+            rs.seq_ = ++lastSeq_;
             rs.isTimeout_ = false;
             rs.expressTs_ = rs.replyTs_ = ndn_getNowMilliseconds();
 
@@ -842,12 +1435,47 @@ bool FaceDAT::RequestsTable::setExpressed(const std::shared_ptr<const ndn::Inter
     return res;
 }
 
+shared_ptr<const FaceDAT::DataFields> FaceDAT::DataFields::fromData(Data &data)
+{
+    shared_ptr<DataFields> f = make_shared<DataFields>();
+    
+    // runs on the Face thread -- an exception here would reset the Face, so a malformed
+    // packet just leaves the rest of the fields empty
+    try
+    {
+        f->name_ = data.getName().toUri();
+        f->fullName_ = data.getFullName()->toUri();
+        // i.e. DigestSha256 signature has no KeyLocator
+        if (KeyLocator::canGetFromSignature(data.getSignature()))
+            f->keyLocator_ = KeyLocator::getFromSignature(data.getSignature()).getKeyName().toUri();
+        BaseDAT::toBase64(data.getSignature()->getSignature(), f->signature_);
+        f->payloadSize_ = (int32_t)data.getContent().size();
+        f->dataSize_ = (int32_t)data.getDefaultWireEncoding().size();
+        f->freshness_ = (int32_t)data.getMetaInfo().getFreshnessPeriod();
+    }
+    catch (std::exception &e)
+    {
+    }
+    
+    return f;
+}
+
 bool FaceDAT::RequestsTable::setData(const std::shared_ptr<const ndn::Interest> &i, const std::shared_ptr<ndn::Data> &data)
 {
     bool res = false;
+    // decode outside of the lock, cook thread may be waiting for it
+    shared_ptr<const DataFields> fields = DataFields::fromData(*data);
     acquireIfExists(*i, [&](RequestsDict &d, RequestsDict::iterator &it){
         it->second.data_ = data;
+        it->second.dataFields_ = fields;
+        it->second.dataMemory_ = make_shared<TrackedMemory>(memory_, data->getDefaultWireEncoding().size());
         it->second.replyTs_ = ndn_getNowMilliseconds();
+        
+        // Karn's rule: replies to retransmitted requests are ambiguous, skip them
+        if (it->second.nRetries_ == 0)
+            updateRto(it->second.getDrd());
+        else
+            nRecovered_++;
     });
     return res;
 }
@@ -869,3 +1497,62 @@ bool FaceDAT::RequestsTable::setNack(const std::shared_ptr<const ndn::Interest>
     });
     return res;
 }
+
+int FaceDAT::RequestsTable::getAttemptLifetime(const Interest &i, uint32_t nRetries)
+{
+    int lifetime = (int)i.getInterestLifetimeMilliseconds();
+    if (!retransmit_)
+        return lifetime;
+    
+    double rto = min((double)RTO_MAX_MS, rto_ * (1 << min(nRetries, 16u)));
+    return (lifetime > 0 ? min(lifetime, (int)rto) : (int)rto);
+}
+
+bool FaceDAT::RequestsTable::checkRetransmit(const Interest &i, bool isNack, uint32_t &delayMs,
+                                             uint64_t &seq)
+{
+    bool res = false;
+    if (!retransmit_)
+        return res;
+    
+    acquireIfExists(i, [&](RequestsDict &d, RequestsDict::iterator &it){
+        if (it->second.isCanceled_)
+            return;
+        
+        if (it->second.nRetries_ >= maxRetries_)
+        {
+            nFailed_++;
+            return;
+        }
+        
+        // timed out attempts have already waited for backed off RTO, Nacks come back
+        // early and wait for it here; both are jittered so that requests which failed
+        // together are not retried in lockstep
+        double backoff = min((double)RTO_MAX_MS, rto_ * (1 << min(it->second.nRetries_, 16u)));
+        uniform_real_distribution<double> u(0., 1.);
+        double delay = (isNack ? backoff * (0.5 + u(rng_)) : backoff * RETX_TIMEOUT_JITTER * u(rng_));
+        
+        it->second.nRetries_++;
+        delayMs = (uint32_t)delay;
+        seq = it->second.seq_;
+        res = true;
+    });
+    return res;
+}
+
+void FaceDAT::RequestsTable::updateRto(uint32_t rttMs)
+{
+    double r = rttMs;
+    if (!hasRttSample_)
+    {
+        srtt_ = r;
+        rttvar_ = r / 2;
+        hasRttSample_ = true;
+    }
+    else
+    {
+        rttvar_ = 0.75 * rttvar_ + 0.25 * fabs(srtt_ - r);
+        srtt_ = 0.875 * srtt_ + 0.125 * r;
+    }
+    rto_ = max((double)RTO_MIN_MS, min((double)RTO_MAX_MS, srtt_ + max((double)RTO_G_MS, 4 * rttvar_)));
+}
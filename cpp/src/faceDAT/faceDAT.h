@@ -22,6 +22,9 @@
 #include <map>
 #include <mutex>
 #include <set>
+#include <chrono>
+#include <atomic>
+#include <random>
 
 #include "DAT_CPlusPlusBase.h"
 #include "baseDAT.hpp"
@@ -50,7 +53,28 @@ namespace touch_ndn
         enum class InfoChopIndex : int32_t {
             FaceProcessing,
             RequestsTableSize,
-            ExpressedNum
+            ExpressedNum,
+            NfdRegistrationsNum,
+            PrefixHandlersNum,
+            PendingInterestsNum,
+            InterestsSentNum,
+            InterestsAggregatedNum,
+            DispatchLatencyUs,
+            DispatchLatencyMaxUs,
+            FaceResetsNum,
+            RecoveryTimeMs,
+            FaceThreadCpuUsage,
+            LogThreadCpuUsage,
+            RetransmissionsNum,
+            RetransmitRecoveredNum,
+            RetransmitFailedNum,
+            RtoMs,
+            PacingQueueSize,
+            PacingDelayUs,
+            DataQueueSize,
+            DataQueueBytes,
+            DataDelayUs,
+            DataDroppedNum
         };
         enum class InfoDatIndex : int32_t {
             // nothing
@@ -89,23 +113,53 @@ namespace touch_ndn
         uint32_t nExpressed_;
         std::shared_ptr<helpers::FaceProcessor> faceProcessor_;
         std::set<std::string> currentOutputs_;
+        // scratch buffer for base64-encoded cells, reused across rows and cooks
+        std::string base64Buffer_;
         std::string keyChainDat_;
+        std::string aggregatePrefix_;
+        std::string processingMode_;
+        std::string faceThreadCpus_, logThreadCpus_;
+        int32_t faceThreadPriority_, faceThreadNice_;
+        // Interest pacing: rate (Interests per second, 0 -- off) and burst for this op
+        // and for the budget shared by all ops
+        int32_t pacingRate_, pacingBurst_, globalPacingRate_, globalPacingBurst_;
+        // outgoing Data shaping, in KB/s and KB (0 rate or limit -- off)
+        int32_t dataRate_, dataBurst_, dataQueueLimit_;
+        // thread CPU usage, in percent of one core, sampled on info CHOP queries
+        uint64_t faceThreadCpuUs_, logThreadCpuUs_;
+        std::chrono::steady_clock::time_point cpuSampleTs_;
+        double faceThreadCpuUsage_, logThreadCpuUsage_;
         KeyChainDAT *keyChainDatOp_;
         std::map<uint64_t, std::string> registeredPrefixes_;
         uint64_t signingCertRegId_, instanceCertRegId_;
         
+        // Data fields shown in the output; decoded once, on the Face thread, when Data
+        // arrives, so that cooks only copy strings
+        typedef struct _DataFields {
+            std::string name_, fullName_, keyLocator_, signature_;
+            int32_t payloadSize_, dataSize_, freshness_;
+            
+            static std::shared_ptr<const _DataFields> fromData(ndn::Data&);
+        } DataFields;
+        
         typedef struct _RequestStatus {
             _RequestStatus(): isTimeout_(false), isCanceled_(false), pitId_(0),
-                expressTs_(0), replyTs_(0) {}
+                seq_(0), nRetries_(0), expressTs_(0), replyTs_(0) {}
             
             uint64_t pitId_;
+            // identifies this entry for delayed retransmissions (entry may be re-created meanwhile)
+            uint64_t seq_;
+            uint32_t nRetries_;
             uint32_t expressTs_, replyTs_;
             uint32_t getDrd(){ return replyTs_ - expressTs_;}
             
             bool isTimeout_, isCanceled_;
             std::shared_ptr<const ndn::Interest> interest_;
             std::shared_ptr<ndn::Data> data_;
+            std::shared_ptr<const DataFields> dataFields_;
             std::shared_ptr<ndn::NetworkNack> nack_;
+            // accounts for data_ bytes while the entry (or its copy) is around
+            std::shared_ptr<TrackedMemory> dataMemory_;
             
             bool isDone() { return data_ || nack_ || isTimeout_; }
         } RequestStatus;
@@ -113,8 +167,25 @@ namespace touch_ndn
         typedef std::map<std::string, RequestStatus> RequestsDict;
         typedef std::pair<const std::string, RequestStatus> RequestsDictPair;
         typedef struct _RequestsTable {
+            _RequestsTable();
+            
             std::recursive_mutex mx_;
             RequestsDict dict_;
+            std::shared_ptr<MemoryCounter> memory_;
+            
+            // retransmission settings, updated from cook thread
+            std::atomic<bool> retransmit_;
+            std::atomic<uint32_t> maxRetries_;
+            std::atomic<uint64_t> nRetransmitted_, nRecovered_, nFailed_;
+            // FaceProcessor pacer Interests are expressed with
+            std::atomic<uint64_t> pacerId_;
+            
+            // RTO estimation (RFC 6298), in milliseconds; guarded by mx_
+            bool hasRttSample_;
+            double srtt_, rttvar_;
+            std::atomic<double> rto_;
+            uint64_t lastSeq_;
+            std::mt19937 rng_;
             
             // mutually acquires access to the table
             void acquire(std::function<void(RequestsDict& d)> f) {
@@ -126,24 +197,58 @@ namespace touch_ndn
             void acquireIfExists(const ndn::Interest&,
                                  std::function<void(RequestsDict& d, RequestsDict::iterator &it)> f);
             
-            bool cancelIfPending(const ndn::Interest&, ndn::Face& f);
+            bool cancelIfPending(const ndn::Interest&, helpers::FaceProcessor& fp);
             bool setExpressed(const std::shared_ptr<const ndn::Interest>&, uint64_t);
             bool setData(const std::shared_ptr<const ndn::Interest>&, const std::shared_ptr<ndn::Data>&);
             bool setTimeout(const std::shared_ptr<const ndn::Interest>&);
             bool setNack(const std::shared_ptr<const ndn::Interest>&, const std::shared_ptr<ndn::NetworkNack>&);
+            
+            // returns lifetime for an attempt of the Interest, backed off by the number of retries
+            int getAttemptLifetime(const ndn::Interest&, uint32_t nRetries);
+            // checks whether failed request should be retried; if so, returns true along with
+            // retransmission delay and entry sequence number
+            bool checkRetransmit(const ndn::Interest&, bool isNack, uint32_t &delayMs, uint64_t &seq);
+            void updateRto(uint32_t rttMs);
         } RequestsTable;
         std::shared_ptr<RequestsTable> requestsTable_;
+        
+        // parsed input DAT rows (or text lines); a row is re-parsed only when its hash changes
+        typedef struct _InputRow {
+            uint64_t hash_;
+            // nullptr for rows with empty name
+            std::shared_ptr<ndn::Interest> interest_;
+            std::string uri_;
+        } InputRow;
+        std::vector<InputRow> inputRows_;
+        // hash of the whole input, if it's a text DAT
+        uint64_t inputTextHash_;
+        std::vector<std::shared_ptr<ndn::Interest>> inputInterests_;
       
         void onOpUpdate(OP_Common*, const std::string&) override;
         
         void initPulsed() override;
         void initFace(DAT_Output*, const OP_Inputs*, void* reserved);
+        void applyFaceThreadOptions();
+        void applyPacing();
+        void applyDataShaping();
+        void sampleThreadsCpuUsage();
         void checkParams(DAT_Output*, const OP_Inputs*, void* reserved) override;
         void paramsUpdated() override;
         
+        // returns true if any of the input rows has changed since the last call
+        bool parseInput(const OP_DATInput*);
+        bool parseInputRow(size_t rowIdx, uint64_t seed, const char* name, size_t nameLen,
+                           const char* lifetime, const char* fresh);
         void express(const std::vector<std::shared_ptr<ndn::Interest>>&, bool);
         void express(std::string prefix, int lifetime, bool mustBeFresh, bool clearTable = false);
         void express(std::shared_ptr<ndn::Interest>&, bool clearTable = false);
+        // expresses one attempt of the request; callbacks are called on Face thread
+        static uint64_t sendRequest(std::shared_ptr<RequestsTable>, helpers::FaceProcessor*,
+                                    std::shared_ptr<helpers::logger>,
+                                    const std::shared_ptr<const ndn::Interest>&, uint32_t nRetries);
+        static bool retransmit(std::shared_ptr<RequestsTable>, helpers::FaceProcessor*,
+                               std::shared_ptr<helpers::logger>,
+                               const std::shared_ptr<const ndn::Interest>&, bool isNack);
         void cancelRequests();
         void outputRequestsTable(DAT_Output *output);
         
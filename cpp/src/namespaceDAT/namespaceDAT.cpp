@@ -25,7 +25,11 @@
 #include <math.h>
 #include <assert.h>
 #include <array>
+#include <chrono>
+#include <deque>
 #include <fstream>
+#include <list>
+#include <unordered_map>
 
 #include <cnl-cpp/namespace.hpp>
 #include <cnl-cpp/segmented-object-handler.hpp>
@@ -33,6 +37,7 @@
 #include <cnl-cpp/generalized-object/generalized-object-stream-handler.hpp>
 
 #include "common/contrib/json11/json11.hpp"
+#include "content-hash.hpp"
 #include "faceDAT.h"
 #include "keyChainDAT.h"
 #include "payloadTOP.hpp"
@@ -41,7 +46,14 @@
 
 #define MODULE_LOGGER "namespaceDAT"
 #define NS_CLEANUP_INTERVAL 10000
-#define GOBJ_STREAM_RETAIN_CHILDREN_NUM 100
+// max number of objects pruned from the Namespace tree in one go
+#define RETENTION_PRUNE_MAX 16
+// Data packets not claimed by any retained object (e.g. _latest, failed fetches) are
+// dropped from byte accounting after this many milliseconds
+#define RETENTION_PENDING_TIMEOUT 10000
+// GObjStream consumer starts with this many objects in flight and opens the pipeline by
+// one object per fetched object (doubles every round trip) up to the configured size
+#define PIPELINE_INITIAL_SIZE 2
 
 #define PAR_PREFIX "Prefix"
 #define PAR_PREFIX_LABEL "Prefix"
@@ -69,6 +81,10 @@
 #define PAR_GOBJ_STREAM_SEQ_LABEL "Seq #"
 #define PAR_GOBJ_STREAM_PP "Pipeline"
 #define PAR_GOBJ_STREAM_PP_LABEL "Pipeline Size"
+#define PAR_GOBJ_STREAM_ONDEMAND "Gobjstreamondemand"
+#define PAR_GOBJ_STREAM_ONDEMAND_LABEL "Interest-driven"
+#define PAR_SKIP_UNCHANGED "Skipunchanged"
+#define PAR_SKIP_UNCHANGED_LABEL "Skip Unchanged"
 
 #define PAR_HANDLER_NONE "Handlernone"
 #define PAR_HANDLER_NONE_LABEL "None"
@@ -80,6 +96,23 @@
 #define PAR_HANDLER_GOSTREAM_LABEL "Generalized Object Stream"
 #define PAR_OBJECT_NEEDED "Objectneeded"
 #define PAR_OBJECT_NEEDED_LABEL "Object Needed"
+#define PAR_PLAYOUT_SIZE "Playoutsize"
+#define PAR_PLAYOUT_SIZE_LABEL "Playout Buffer"
+#define PAR_PLAYOUT_MODE "Playoutmode"
+#define PAR_PLAYOUT_MODE_LABEL "Playout Mode"
+
+#define PAR_PAGE_RETENTION "Retention"
+#define PAR_RETAIN_OBJECTS "Retainobjects"
+#define PAR_RETAIN_OBJECTS_LABEL "Max Objects"
+#define PAR_RETAIN_SIZE "Retainsize"
+#define PAR_RETAIN_SIZE_LABEL "Max Size (MB)"
+#define PAR_RETAIN_AGE "Retainage"
+#define PAR_RETAIN_AGE_LABEL "Max Age (sec)"
+
+#define PAR_PLAYOUT_COOK "Playoutcook"
+#define PAR_PLAYOUT_COOK_LABEL "Cook"
+#define PAR_PLAYOUT_TIMESTAMP "Playouttimestamp"
+#define PAR_PLAYOUT_TIMESTAMP_LABEL "Timestamp"
 
 using namespace std;
 using namespace std::placeholders;
@@ -95,6 +128,24 @@ const map<string, NamespaceDAT::HandlerType> HandlerTypeMap = {
     { PAR_HANDLER_GOSTREAM, NamespaceDAT::HandlerType::GObjStream },
 };
 
+const map<string, NamespaceDAT::PlayoutMode> PlayoutModeMap = {
+    { PAR_PLAYOUT_COOK, NamespaceDAT::PlayoutMode::Cook },
+    { PAR_PLAYOUT_TIMESTAMP, NamespaceDAT::PlayoutMode::Timestamp },
+};
+
+const map<NamespaceDAT::InfoChopIndex, string> NamespaceDAT::ChanNames = {
+    { NamespaceDAT::InfoChopIndex::PlayoutDepth, "playoutDepth" },
+    { NamespaceDAT::InfoChopIndex::PlayoutUnderruns, "playoutUnderruns" },
+    { NamespaceDAT::InfoChopIndex::PlayoutReleased, "playoutReleased" },
+    { NamespaceDAT::InfoChopIndex::PlayoutDropped, "playoutDropped" },
+    { NamespaceDAT::InfoChopIndex::RetainedObjects, "retainedObjects" },
+    { NamespaceDAT::InfoChopIndex::RetainedPackets, "retainedPackets" },
+    { NamespaceDAT::InfoChopIndex::RetainedBytes, "retainedBytes" },
+    { NamespaceDAT::InfoChopIndex::PrunedObjects, "prunedObjects" },
+    { NamespaceDAT::InfoChopIndex::SkippedInputs, "skippedInputs" },
+    { NamespaceDAT::InfoChopIndex::SkippedPublishes, "skippedPublishes" }
+};
+
 const map<NamespaceState, string> NamespaceStateMap = {
     { NamespaceState_NAME_EXISTS, "NAME_EXISTS" },
     { NamespaceState_INTEREST_EXPRESSED, "INTEREST_EXPRESSED" },
@@ -163,85 +214,262 @@ extern "C"
 
 class NamespaceDAT::Impl : public enable_shared_from_this<NamespaceDAT::Impl> {
 public:
-    // ObjectReadyPayload holds published/fetched object and relevant metadata
-    // On the Face thread, acquire lock to write
-    // On the main TD thread, try to acquire lock, skip if can't acquire lock
-    typedef struct _ObjectReadyPayload {
-        // NamespaceData copies data from namespace that may be
-        // required later by TouchDesigner (state, namespace name, packets).
-        typedef struct _NamespaceData {
-            NamespaceState state_;
-            string objectNamespaceName_;
-            vector<shared_ptr<Data>> allPackets_;
-            
-            void reset() {
-                state_ = NamespaceState_NAME_EXISTS;
-                objectNamespaceName_ = "";
-                allPackets_.clear();
-            }
-            void fromNamespace(Namespace& n){
-                state_ = n.getState();
-                objectNamespaceName_ = n.getName().toUri();
-                allPackets_.clear();
-                n.getAllData(allPackets_);
-            }
-        } NamespaceData;
+    // ObjectSnapshot is an immutable view of a published/fetched object and its metadata.
+    // It is created on the Face thread and published with atomic_store; the main TD
+    // thread picks up the latest one with atomic_load. Packet names are not collected
+    // upfront -- they're enumerated on the Face thread once info DAT asks for them.
+    typedef struct _ObjectSnapshot {
+        typedef vector<string> PacketNames;
         
-        recursive_mutex mtx_;
-        NamespaceData namespaceData_;
+        NamespaceState state_;
+        Name objectName_;
         shared_ptr<Object> object_;
         shared_ptr<ContentMetaInfoObject> contentMetaInfo_;
-        uint64_t updatedTs_, readTs_;
+        uint64_t updatedTs_;
         // only for GObjStream
         bool isGobjStream_;
-        int64_t seqNo_, fetchedNum_;
+        int64_t seqNo_;
         
-        void reset(){
-            lock_guard<recursive_mutex> scopedLock(mtx_);
-            namespaceData_.reset();
-            object_.reset();
-            contentMetaInfo_.reset();
-            seqNo_ = -1;
-            fetchedNum_ = 0;
-            updatedTs_ = 0;
-            readTs_ = 0;
-            isGobjStream_ = false;
-        }
+        // filled lazily, see requestPacketNames()
+        mutable shared_ptr<const PacketNames> packetNames_;
+        mutable atomic<bool> packetNamesRequested_;
         
-        void fromNamespace(Namespace &n, bool isGobjStream = false)
+        _ObjectSnapshot(): state_(NamespaceState_NAME_EXISTS), updatedTs_(0),
+            isGobjStream_(false), seqNo_(-1), packetNamesRequested_(false) {}
+        
+        static shared_ptr<_ObjectSnapshot> fromNamespace(Namespace &n, bool isGobjStream = false,
+                                                         shared_ptr<ContentMetaInfoObject> contentMetaInfo = nullptr)
         {
-            namespaceData_.fromNamespace(n);
-            object_ = n.getObject();
-            isGobjStream_ = isGobjStream;
+            shared_ptr<_ObjectSnapshot> s = make_shared<_ObjectSnapshot>();
+            s->state_ = n.getState();
+            s->objectName_ = n.getName();
+            s->object_ = n.getObject();
+            s->isGobjStream_ = isGobjStream;
+            s->updatedTs_ = ndn_getNowMilliseconds();
+            s->contentMetaInfo_ = contentMetaInfo;
             
             // check for gobj
             if (n.hasChild(Name::Component("_meta")))
             {
-                shared_ptr<Object> metaObject = n[Name::Component("_meta")].getObject();
-                shared_ptr<ContentMetaInfoObject> cMetaInfoObject = dynamic_pointer_cast<ContentMetaInfoObject>(metaObject);
-                if (cMetaInfoObject)
+                if (!s->contentMetaInfo_)
+                    s->contentMetaInfo_ = getContentMetaInfo(n);
+                if (isGobjStream)
+                    s->seqNo_ = n.getName()[-1].toSequenceNumber();
+            }
+            
+            return s;
+        }
+        
+        static shared_ptr<ContentMetaInfoObject> getContentMetaInfo(Namespace &n)
+        {
+            shared_ptr<Object> metaObject = n[Name::Component("_meta")].getObject();
+            shared_ptr<ContentMetaInfoObject> cMetaInfoObject = dynamic_pointer_cast<ContentMetaInfoObject>(metaObject);
+            if (!cMetaInfoObject && metaObject)
+            {
+                ndntools::ContentMetaInfo cMetaInfo;
+                cMetaInfo.wireDecode(n[Name::Component("_meta")].getBlobObject());
+                cMetaInfoObject = make_shared<ContentMetaInfoObject>(cMetaInfo);
+            }
+            return cMetaInfoObject;
+        }
+        
+        bool isObjectReady() const {
+            return objectName_.size() &&
+                   (state_ == NamespaceState_OBJECT_READY ||
+                    (isGobjStream_ && state_ == NamespaceState_PRODUCING_OBJECT)) &&
+                   object_;
+        }
+        
+        shared_ptr<const PacketNames> getPacketNames() const { return atomic_load(&packetNames_); }
+        
+        // returns true only for the first caller
+        bool markPacketNamesRequested() const { return !packetNamesRequested_.exchange(true); }
+        
+        // must be called on the Face thread
+        void enumeratePackets(Namespace &root) const
+        {
+            shared_ptr<PacketNames> names = make_shared<PacketNames>();
+            Namespace *n = nullptr;
+            
+            if (root.getName().equals(objectName_))
+                n = &root;
+            else if (root.getName().isPrefixOf(objectName_) && root.hasChild(objectName_))
+                n = &root.getChild(objectName_);
+            
+            // object may have been cleaned up already
+            if (n)
+            {
+                vector<shared_ptr<Data>> allPackets;
+                n->getAllData(allPackets);
+                names->reserve(allPackets.size());
+                for (auto &d:allPackets)
+                    names->push_back(d->getName().toUri());
+            }
+            atomic_store(&packetNames_, shared_ptr<const PacketNames>(names));
+        }
+    } ObjectSnapshot;
+    
+    // PlayoutBuffer holds up to K fetched GObjStream objects ahead of the output and
+    // releases them on the cook thread -- either paced by objects' arrival rate or by
+    // their ContentMetaInfo timestamps. Objects are pushed on the Face thread. Buffer
+    // fills up to K only at start; on underrun output holds the last object.
+    class PlayoutBuffer {
+    public:
+        typedef struct _Entry {
+            int64_t seqNo_;
+            shared_ptr<const ObjectSnapshot> snapshot_;
+        } Entry;
+        
+        PlayoutBuffer()
+        : size_(0), mode_(PlayoutMode::Cook)
+        , arrivalIntervalUs_(0)
+        , underruns_(0), released_(0), dropped_(0) { reset(); }
+        
+        void configure(size_t size, PlayoutMode mode)
+        {
+            lock_guard<mutex> scopedLock(mtx_);
+            size_ = size;
+            mode_ = mode;
+            reset();
+        }
+        
+        bool isEnabled() const { return size_ > 0; }
+        
+        void push(Entry &&e)
+        {
+            lock_guard<mutex> scopedLock(mtx_);
+            
+            if (e.seqNo_ <= lastSeqNo_)
+            {
+                // arrived after its slot has been played out
+                dropped_++;
+                return;
+            }
+            
+            // objects may arrive out of order when pipelining
+            auto it = entries_.begin();
+            while (it != entries_.end() && it->seqNo_ < e.seqNo_) ++it;
+            if (it != entries_.end() && it->seqNo_ == e.seqNo_)
+                return;
+            entries_.insert(it, move(e));
+            
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (lastArrivalTs_ != chrono::steady_clock::time_point())
+            {
+                uint32_t intervalUs = (uint32_t)chrono::duration_cast<chrono::microseconds>(now - lastArrivalTs_).count();
+                arrivalIntervalUs_ = (arrivalIntervalUs_ ? (7*arrivalIntervalUs_ + intervalUs) / 8 : intervalUs);
+            }
+            lastArrivalTs_ = now;
+            
+            // don't let the buffer grow unbounded if output isn't cooking
+            while (entries_.size() > 2*size_)
+            {
+                lastSeqNo_ = entries_.front().seqNo_;
+                entries_.pop_front();
+                dropped_++;
+            }
+        }
+        
+        // returns true if an entry is due for the output
+        bool release(Entry &e)
+        {
+            lock_guard<mutex> scopedLock(mtx_);
+            
+            if (buffering_)
+            {
+                if (entries_.size() < size_)
+                    return false;
+                buffering_ = false;
+                localBaseTs_ = chrono::steady_clock::time_point();
+            }
+            
+            if (entries_.empty())
+            {
+                // rebuffering to K would freeze output for K frames every time cooking
+                // outpaces the stream, hold the last object instead; timestamp pacing
+                // re-syncs at the next object
+                underruns_++;
+                localBaseTs_ = chrono::steady_clock::time_point();
+                return false;
+            }
+            
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (mode_ == PlayoutMode::Timestamp && entries_.front().snapshot_->contentMetaInfo_)
+            {
+                if (localBaseTs_ == chrono::steady_clock::time_point())
                 {
-                    contentMetaInfo_ = cMetaInfoObject;
+                    localBaseTs_ = now;
+                    mediaBaseTs_ = entries_.front().snapshot_->contentMetaInfo_->getTimestamp();
                 }
-                else if (metaObject)
+                
+                // release the latest due entry, skipping those we're late for
+                bool due = false;
+                while (entries_.size() && isDue(entries_.front(), now))
                 {
-                    ndntools::ContentMetaInfo cMetaInfo;
-                    cMetaInfo.wireDecode(n[Name::Component("_meta")].getBlobObject());
-                    contentMetaInfo_ = make_shared<ContentMetaInfoObject>(cMetaInfo);
+                    if (due) dropped_++;
+                    e = move(entries_.front());
+                    entries_.pop_front();
+                    due = true;
                 }
+                if (!due)
+                    return false;
+            }
+            else
+            {
+                // cook may run faster than the stream -- release no faster than objects
+                // arrive, unless the buffer has grown past K
+                if (entries_.size() <= size_ && arrivalIntervalUs_ &&
+                    now - lastReleaseTs_ < chrono::microseconds(arrivalIntervalUs_))
+                    return false;
                 
-                if (isGobjStream_)
-                    seqNo_ = n.getName()[-1].toSequenceNumber();
+                e = move(entries_.front());
+                entries_.pop_front();
             }
+            
+            lastSeqNo_ = e.seqNo_;
+            lastReleaseTs_ = now;
+            released_++;
+            return true;
         }
         
-        bool isObjectReady() const {
-            return namespaceData_.objectNamespaceName_.size() &&
-                   (namespaceData_.state_ == NamespaceState_OBJECT_READY ||
-                    (isGobjStream_ && namespaceData_.state_ == NamespaceState_PRODUCING_OBJECT)) &&
-                   object_;
+        size_t getDepth() { lock_guard<mutex> scopedLock(mtx_); return entries_.size(); }
+        int64_t getLastSeqNo() { lock_guard<mutex> scopedLock(mtx_); return lastSeqNo_; }
+        uint64_t getUnderruns() const { return underruns_; }
+        uint64_t getReleased() const { return released_; }
+        uint64_t getDropped() const { return dropped_; }
+        
+    private:
+        mutex mtx_;
+        deque<Entry> entries_;
+        // read without locking by isEnabled()
+        atomic<size_t> size_;
+        PlayoutMode mode_;
+        bool buffering_;
+        int64_t lastSeqNo_;
+        double mediaBaseTs_;
+        chrono::steady_clock::time_point localBaseTs_, lastArrivalTs_, lastReleaseTs_;
+        uint32_t arrivalIntervalUs_;
+        atomic<uint64_t> underruns_, released_, dropped_;
+        
+        void reset()
+        {
+            entries_.clear();
+            buffering_ = true;
+            lastSeqNo_ = -1;
+            mediaBaseTs_ = 0;
+            localBaseTs_ = lastArrivalTs_ = lastReleaseTs_ = chrono::steady_clock::time_point();
+            arrivalIntervalUs_ = 0;
         }
-    } ObjectReadyPayload;
+        
+        bool isDue(const Entry& e, const chrono::steady_clock::time_point& now) const
+        {
+            if (!e.snapshot_->contentMetaInfo_)
+                return true;
+            double mediaOffsetMs = e.snapshot_->contentMetaInfo_->getTimestamp() - mediaBaseTs_;
+            double localOffsetMs = chrono::duration<double, milli>(now - localBaseTs_).count();
+            return mediaOffsetMs <= localOffsetMs;
+        }
+    };
     
     class PayloadData {
     public:
@@ -290,91 +518,210 @@ public:
     shared_ptr<helpers::logger> logger_;
     shared_ptr<helpers::FaceProcessor> faceProcessor_;
     HandlerType handlerType_;
+    // set for producers only
+    KeyChain *keyChain_;
     shared_ptr<Namespace> namespace_;
+    // consumer's Namespace expresses Interests on this Face, so they are paced (and
+    // aggregated) by FaceProcessor; accessed on the Face thread only
+    shared_ptr<Face> pacingFace_;
     vector<uint64_t> registeredCallbacks_;
     bool prefixRegistered_;
-    ObjectReadyPayload objectReadyPayload_;
-    Name lastVersion_;
+    // latest object, use getSnapshot()/setSnapshot() to access
+    shared_ptr<const ObjectSnapshot> snapshot_;
+    atomic<int64_t> fetchedNum_;
+    // snapshots last written to DAT output and payload output (main TD thread only)
+    shared_ptr<const ObjectSnapshot> outputSnapshot_, storedSnapshot_;
+    PlayoutBuffer playout_;
     shared_ptr<GeneralizedObjectStreamHandler> streamHandler_;
     helpers::FaceResetConnection faceResetConnection_;
+    helpers::FaceRecoveredConnection faceRecoveredConnection_;
+    // set on the Face thread when Face is re-created, namespace is re-attached on next cook
+    atomic<bool> faceRecovered_;
+    // next fetch continues into current output and playout buffer (main TD thread only)
+    bool resumeFetch_;
+    // Interest-driven GObjStream producer state, accessed on the Face thread only
+    int64_t demandedSeqNo_;
+    shared_ptr<PayloadData> stagedPayload_;
+    // objects kept in the Namespace tree, oldest first, and the wire size of their Data
+    // packets; accessed on the Face thread only
+    typedef struct _RetainedObject {
+        Name name_;
+        // GObjStream sequence number of fetched objects, -1 otherwise
+        int64_t seqNo_;
+        int64_t nPackets_, nBytes_;
+        chrono::steady_clock::time_point ts_;
+    } RetainedObject;
+    list<RetainedObject> retainedObjects_;
+    unordered_map<string, list<RetainedObject>::iterator> retainedIndex_;
+    // wire size of Data packets received or produced, until claimed by the retained
+    // object they belong to; accessed on the Face thread only
+    typedef struct _PendingData {
+        size_t nBytes_;
+        chrono::steady_clock::time_point ts_;
+    } PendingData;
+    map<Name, PendingData> pendingData_;
+    int64_t totalPackets_, totalBytes_;
+    RetentionPolicy retention_;
+    TrackedMemory namespaceMemory_;
+    // retention stats, read on the main TD thread
+    atomic<int64_t> retainedObjectsNum_, retainedPacketsNum_, retainedBytes_, prunedObjectsNum_;
+    // main TD thread only
+    chrono::steady_clock::time_point lastRetentionCheck_;
     
-    Impl(shared_ptr<helpers::logger> &l, HandlerType ht) :
+    Impl(shared_ptr<helpers::logger> &l, HandlerType ht, const RetentionPolicy& retention,
+         shared_ptr<MemoryCounter> namespaceMemory) :
     handlerType_(ht)
+    , keyChain_(nullptr)
     , prefixRegistered_(false)
+    , fetchedNum_(0)
+    , faceRecovered_(false)
+    , resumeFetch_(false)
+    , demandedSeqNo_(-1)
+    , totalPackets_(0)
+    , totalBytes_(0)
+    , retention_(retention)
+    , namespaceMemory_(namespaceMemory)
+    , retainedObjectsNum_(0)
+    , retainedPacketsNum_(0)
+    , retainedBytes_(0)
+    , prunedObjectsNum_(0)
     , logger_(l) {}
     
     ~Impl(){
-        if (faceProcessor_) faceResetConnection_.disconnect();
+        if (faceProcessor_)
+        {
+            faceResetConnection_.disconnect();
+            faceRecoveredConnection_.disconnect();
+        }
     }
     
     bool getIsObjectReady() const
     {
-        return namespace_ &&
-            //(//namespace_->getState() == NamespaceState_OBJECT_READY || // <-- this condition not sufficient
-        objectReadyPayload_.isObjectReady(); // ||
-             //(namespace_->getState() == NamespaceState_PRODUCING_OBJECT && handlerType_ == HandlerType::GObjStream));
+        shared_ptr<const ObjectSnapshot> snapshot = getSnapshot();
+        return namespace_ && snapshot && snapshot->isObjectReady();
     }
     
-    bool tryLockObjectReady(function<void(ObjectReadyPayload&)> cb)
-    {
-        unique_lock<recursive_mutex> lock(objectReadyPayload_.mtx_, try_to_lock);
-        if (lock.owns_lock())
-        {
-            cb(objectReadyPayload_);
-            return true;
-        }
-        return false;
-    }
+    shared_ptr<const ObjectSnapshot> getSnapshot() const { return atomic_load(&snapshot_); }
+    void setSnapshot(shared_ptr<const ObjectSnapshot> snapshot) { atomic_store(&snapshot_, snapshot); }
     
-    void lockObjectReady(function<void(const ObjectReadyPayload&)> cb)
+    void resetSnapshot()
     {
-        lock_guard<recursive_mutex> scopedLock(objectReadyPayload_.mtx_);
-        cb(objectReadyPayload_);
+        setSnapshot(nullptr);
+        fetchedNum_ = 0;
     }
-
-    void lockObjectReady(function<void(ObjectReadyPayload&)> cb)
+    
+    // kicks off packet enumeration on the Face thread; returns packet names, if available
+    shared_ptr<const ObjectSnapshot::PacketNames> requestPacketNames(const shared_ptr<const ObjectSnapshot>& snapshot)
     {
-        lock_guard<recursive_mutex> scopedLock(objectReadyPayload_.mtx_);
-        cb(objectReadyPayload_);
+        shared_ptr<const ObjectSnapshot::PacketNames> names = snapshot->getPacketNames();
+        if (!names && snapshot->markPacketNamesRequested())
+        {
+            shared_ptr<Namespace> n = namespace_;
+            if (n)
+                faceProcessor_->dispatchSynchronized([n, snapshot](shared_ptr<Face>){
+                    snapshot->enumeratePackets(*n);
+                });
+        }
+        return names;
     }
     
     void initNamespace(string prefix, KeyChain *keyChain, shared_ptr<helpers::FaceProcessor> faceProcessor)
     {
-        if (faceProcessor_) faceResetConnection_.disconnect();
+        if (faceProcessor_)
+        {
+            faceResetConnection_.disconnect();
+            faceRecoveredConnection_.disconnect();
+        }
         faceProcessor_ = faceProcessor;
         
         shared_ptr<Impl> me = shared_from_this();
         faceResetConnection_ = faceProcessor_->onFaceReset_.connect([me, this](const shared_ptr<Face>&, const exception&){
-            namespace_->shutdown();
-            namespace_->setFace(nullptr);
-            namespace_.reset();
+            // Namespace keeps raw Face pointer, detach it before Face is gone; producer's
+            // Namespace is re-attached on recovery, consumer's one is replaced
+            shared_ptr<Namespace> n = namespace_;
+            if (n)
+            {
+                if (!keyChain_)
+                    n->shutdown();
+                n->setFace(nullptr);
+            }
+            pacingFace_.reset();
+            prefixRegistered_ = false;
+        });
+        faceRecoveredConnection_ = faceProcessor_->onFaceRecovered_.connect([me, this](const shared_ptr<Face>&){
+            faceRecovered_ = true;
         });
 
-        objectReadyPayload_.reset();
+        resetSnapshot();
+        keyChain_ = keyChain;
+        createNamespace(prefix);
+    }
+    
+    // re-attaches to the new Face after Face recovery. Producer keeps its Namespace, hence
+    // published objects and stream sequence number. Consumer's pending Interests went away
+    // with the old Face, so fetching resumes in a fresh Namespace, while output, playout
+    // buffer and stats are kept
+    void recoverFace()
+    {
+        if (!keyChain_)
+        {
+            Name prefix = namespace_->getName();
+            detachNamespace();
+            createNamespace(prefix);
+            resumeFetch_ = true;
+        }
+        setFace(keyChain_ != nullptr);
+    }
+    
+    void createNamespace(const Name& prefix)
+    {
+        shared_ptr<Impl> me = shared_from_this();
+        namespace_ = make_shared<Namespace>(prefix, keyChain_);
         
-        namespace_ = make_shared<Namespace>(prefix, keyChain);
+        // account packets as they're set in the tree, so retaining an object doesn't
+        // have to walk its packets
+        uint64_t cbId =
+        namespace_->addOnStateChanged([me](Namespace& n, Namespace& changedNamespace, NamespaceState state, uint64_t)
+                                      {
+                                          if ((state == NamespaceState_DATA_RECEIVED ||
+                                               state == NamespaceState_OBJECT_READY) &&
+                                              changedNamespace.getData())
+                                              me->addPendingData(*changedNamespace.getData());
+                                      });
+        registeredCallbacks_.push_back(cbId);
     }
     
     void releaseNamespace()
     {
         if (namespace_)
-        {
-            // since removeCallback call and setFace access internal structures of Namespace
-            // which can be accessed through callbacks (i.e. on the Face thread), we need
-            // to sync clean up with the Face thread here
-            vector<uint64_t> registeredCbs = registeredCallbacks_;
-            shared_ptr<Namespace> n = namespace_;
-            faceProcessor_->dispatchSynchronized([n, registeredCbs](shared_ptr<Face> f){
-                for (auto cbId:registeredCbs)
-                    n->removeCallback(cbId);
-                n->shutdown();
-                n->setFace(nullptr);
-            });
-            
-            streamHandler_.reset();
-            namespace_ = shared_ptr<Namespace>();
-            lastVersion_.clear();
-        }
+            detachNamespace();
+    }
+    
+    // retained objects go away along with the Namespace tree
+    void detachNamespace()
+    {
+        // since removeCallback call and setFace access internal structures of Namespace
+        // which can be accessed through callbacks (i.e. on the Face thread), we need
+        // to sync clean up with the Face thread here
+        vector<uint64_t> registeredCbs = registeredCallbacks_;
+        registeredCallbacks_.clear();
+        shared_ptr<Namespace> n = namespace_;
+        shared_ptr<Impl> me = shared_from_this();
+        faceProcessor_->dispatchSynchronized([n, me, registeredCbs](shared_ptr<Face> f){
+            for (auto cbId:registeredCbs)
+                n->removeCallback(cbId);
+            n->shutdown();
+            n->setFace(nullptr);
+            me->pacingFace_.reset();
+            me->retainedObjects_.clear();
+            me->retainedIndex_.clear();
+            me->pendingData_.clear();
+            me->totalPackets_ = me->totalBytes_ = 0;
+            me->updateRetentionStats();
+        });
+        
+        streamHandler_.reset();
+        namespace_ = shared_ptr<Namespace>();
     }
     
     void setFace(bool registerPrefix = false)
@@ -395,7 +742,10 @@ public:
                                    me->logger_->debug("Registered prefix {}", n->toUri());
                                });
             else
-                namespace_->setFace(f.get());
+            {
+                pacingFace_ = faceProcessor_->makePacingFace(*f);
+                namespace_->setFace(pacingFace_.get());
+            }
             
 //            shared_ptr<Namespace> nm = namespace_;
 //            uint64_t cbId =
@@ -427,12 +777,57 @@ public:
         registeredCallbacks_.push_back(cbId);
     }
     
+    int64_t getProducedSeqNo() const
+    {
+        return streamHandler_ ? streamHandler_->getProducedSequenceNumber() : -1;
+    }
+    
+    // Interest-driven GObjStream producer: tracks highest sequence number requested by
+    // incoming Interests. Staged object is published as soon as consumers ask for a
+    // sequence number that is not produced yet (or have caught up with the produced one),
+    // so pipelined Interests get answered right away and at most one object is
+    // produced ahead of the consumers.
+    void produceOnInterest()
+    {
+        shared_ptr<Impl> me = shared_from_this();
+        uint64_t cbId =
+        namespace_->addOnObjectNeeded([this,me](Namespace& n, Namespace& neededNamespace, uint64_t)
+        {
+            const Name &prefix = namespace_->getName();
+            const Name &needed = neededNamespace.getName();
+            
+            if (needed.size() > prefix.size() && needed[prefix.size()].isSequenceNumber() &&
+                prefix.isPrefixOf(needed))
+            {
+                demandedSeqNo_ = max<int64_t>(demandedSeqNo_, (int64_t)needed[prefix.size()].toSequenceNumber());
+                publishStaged();
+            }
+            return false;
+        });
+        registeredCallbacks_.push_back(cbId);
+    }
+    
+    // must be called on the Face thread
+    void stage(shared_ptr<PayloadData> payloadData)
+    {
+        stagedPayload_ = payloadData;
+        publishStaged();
+    }
+    
+    void publishStaged()
+    {
+        if (stagedPayload_ && demandedSeqNo_ >= getProducedSeqNo())
+        {
+            shared_ptr<PayloadData> pd = stagedPayload_;
+            stagedPayload_.reset();
+            produceNow(*namespace_, pd);
+            
+            logger_->trace("Interest-driven publish: seq {} demanded {}", getProducedSeqNo(), demandedSeqNo_);
+        }
+    }
+    
     bool produceNow(Namespace &n, shared_ptr<PayloadData> payloadData, bool versioned = false)
     {
-        lock_guard<recursive_mutex> scopedLock(objectReadyPayload_.mtx_);
-        
-        objectReadyPayload_.reset();
-        
         uint64_t versionNo = ndn_getNowMilliseconds();
         Namespace &publishNamespace = versioned ? n[Name::Component::fromVersion(versionNo)] : n;
         publishNamespace.setNewDataMetaInfo(payloadData->metaInfo_);
@@ -471,11 +866,6 @@ public:
                         streamHandler_->addObject(*pd->payload_, pd->contentType_, *pd->other_);
                     else
                         streamHandler_->addObject(*pd->payload_, pd->contentType_);
-                    
-                    // cleanup older children
-                    int cleanupSeq = streamHandler_->getProducedSequenceNumber() - GOBJ_STREAM_RETAIN_CHILDREN_NUM;
-                    if (cleanupSeq >= 0)
-                        (*namespace_)[Name::Component::fromSequenceNumber(cleanupSeq)].experimentalClear();
                 }
                     break;
                 default:
@@ -486,22 +876,19 @@ public:
                 (handlerType_ == HandlerType::GObjStream ?
                  publishNamespace[Name::Component::fromSequenceNumber(streamHandler_->getProducedSequenceNumber())] :
                  publishNamespace);
-            objectReadyPayload_.fromNamespace(objectNamespace,
-                                              handlerType_ == HandlerType::GObjStream);
+            retainObject(objectNamespace);
+            setSnapshot(ObjectSnapshot::fromNamespace(objectNamespace,
+                                                      handlerType_ == HandlerType::GObjStream));
             
             logger_->debug("Published data under {}: ",
                            publishNamespace.getName().toUri(),
                            objectNamespace.getName().toUri());
             
-            // cleanup last version
-            if (lastVersion_.size())
-                n.getChild(Name(n.getName()).append(lastVersion_)).experimentalClear();
-            if (versioned) lastVersion_ = objectNamespace.getName().getSubName(-1);
-            
             return true;
         }
         catch (std::runtime_error &e)
         {
+            resetSnapshot();
             logger_->error("Error while publishing: {}", e.what());
         }
         
@@ -510,7 +897,9 @@ public:
     
     void fetch(bool mustBeFresh, bool versioned = false, int pipelineSize = 8)
     {
-        objectReadyPayload_.reset();
+        if (!resumeFetch_)
+            resetSnapshot();
+        resumeFetch_ = false;
         
         shared_ptr<Impl> me = shared_from_this();
         switch (handlerType_)
@@ -522,14 +911,14 @@ public:
                 uint64_t cbId =
                 namespace_->addOnStateChanged([this,me](Namespace& n, Namespace& on, NamespaceState state, uint64_t cbId)
                                               {
-                                                  cout << n.getName() << " " << on.getName() << " " << NamespaceStateMap.at(state) << endl;
+                                                  if (me->logger_->should_log(spdlog::level::trace))
+                                                      me->logger_->trace("{} {} {}", n.getName().toUri(),
+                                                                         on.getName().toUri(),
+                                                                         NamespaceStateMap.at(state));
                                                   if (state == NamespaceState_OBJECT_READY)
                                                   {
-                                                      me->lockObjectReady([&](ObjectReadyPayload& p){
-//                                                          cout << "INSIDE" << endl;
-                                                          p.updatedTs_ = ndn_getNowMilliseconds();
-                                                          p.fromNamespace(on);
-                                                      });
+                                                      me->retainObject(on);
+                                                      me->setSnapshot(ObjectSnapshot::fromNamespace(on));
                                                   }
                                               });
                 registeredCallbacks_.push_back(cbId);
@@ -539,10 +928,8 @@ public:
             case HandlerType::Segmented:
                 SegmentedObjectHandler(namespace_.get(), [this,me](Namespace& objectNamespace)
                                        {
-                                           me->lockObjectReady([&](ObjectReadyPayload& p){
-                                               p.updatedTs_ = ndn_getNowMilliseconds();
-                                               p.fromNamespace(objectNamespace);
-                                           });
+                                           me->retainObject(objectNamespace);
+                                           me->setSnapshot(ObjectSnapshot::fromNamespace(objectNamespace));
                                        }).objectNeeded(mustBeFresh);
                 logger_->debug("Segmented data requested {}", namespace_->getName().toUri());
                 break;
@@ -553,10 +940,8 @@ public:
                 [this,me,versioned] (const shared_ptr<ContentMetaInfoObject> &contentMetaInfo,
                            Namespace &objectNamespace)
                 {
-                    me->lockObjectReady([&](ObjectReadyPayload& p){
-                        p.updatedTs_ = ndn_getNowMilliseconds();
-                        p.fromNamespace(objectNamespace);
-                    });
+                    me->retainObject(objectNamespace);
+                    me->setSnapshot(ObjectSnapshot::fromNamespace(objectNamespace, false, contentMetaInfo));
                 };
                 
                 if (handlerType_ == HandlerType::GObj)
@@ -568,26 +953,43 @@ public:
                 }
                 else
                 {
+                    // handler owns the callback, hence weak reference
+                    shared_ptr<weak_ptr<GeneralizedObjectStreamHandler>> handler =
+                        make_shared<weak_ptr<GeneralizedObjectStreamHandler>>();
                     GeneralizedObjectStreamHandler::OnSequencedGeneralizedObject onSeqObject =
-                    [this,me,onObject] (int sequenceNumber,
-                                        const shared_ptr<ContentMetaInfoObject>& contentMetaInfo,
-                                        Namespace& objectNamespace)
+                    [this,me,handler,pipelineSize] (int sequenceNumber,
+                               const shared_ptr<ContentMetaInfoObject>& contentMetaInfo,
+                               Namespace& objectNamespace)
                     {
-                        me->lockObjectReady([&](ObjectReadyPayload& p){
-                            p.seqNo_ = sequenceNumber;
-                            p.fetchedNum_++;
-                            p.isGobjStream_ = true;
-                        });
-                        onObject(contentMetaInfo, objectNamespace);
+                        shared_ptr<ObjectSnapshot> snapshot = ObjectSnapshot::fromNamespace(objectNamespace, true,
+                                                                                            contentMetaInfo);
+                        snapshot->seqNo_ = sequenceNumber;
+                        me->fetchedNum_++;
+                        me->retainObject(objectNamespace, sequenceNumber);
+                        
+                        if (me->playout_.isEnabled())
+                        {
+                            PlayoutBuffer::Entry e;
+                            e.seqNo_ = sequenceNumber;
+                            e.snapshot_ = snapshot;
+                            me->playout_.push(move(e));
+                        }
+                        else
+                            me->setSnapshot(snapshot);
                         
-                        // cleanup old chidlren
-                        int cleanupSeqNo = (int)objectNamespace.getName()[-1].toSequenceNumber() - GOBJ_STREAM_RETAIN_CHILDREN_NUM;
-                        if (cleanupSeqNo >= 0)
-                            (*namespace_)[Name::Component::fromSequenceNumber(cleanupSeqNo)].experimentalClear();
+                        shared_ptr<GeneralizedObjectStreamHandler> h = handler->lock();
+                        if (h && h->getPipelineSize() < pipelineSize)
+                            h->setPipelineSize(h->getPipelineSize() + 1);
                     };
                     if (!streamHandler_)
+                    {
+                        // don't open the whole pipeline at once -- that's a burst of Interests
+                        // on every (re)start
                         streamHandler_ = make_shared<GeneralizedObjectStreamHandler>(namespace_.get(),
-                                                                                     pipelineSize, onSeqObject);
+                                                                                     min(pipelineSize, PIPELINE_INITIAL_SIZE),
+                                                                                     onSeqObject);
+                        *handler = streamHandler_;
+                    }
                     streamHandler_->objectNeeded();
                 }
             }
@@ -597,29 +999,191 @@ public:
         }
     }
     
-    static vector<pair<string,string>> datInfoFromObjectPayload(const ObjectReadyPayload &p)
+    void setRetentionPolicy(const RetentionPolicy& retention)
+    {
+        if (!faceProcessor_)
+        {
+            retention_ = retention;
+            return;
+        }
+        
+        shared_ptr<Impl> me = shared_from_this();
+        faceProcessor_->dispatchSynchronized([me, retention](shared_ptr<Face>){
+            me->retention_ = retention;
+            me->enforceRetention();
+        });
+    }
+    
+    // objects are pruned as new ones arrive; age limit (and backlog left after limits were
+    // lowered) is also checked periodically from the main TD thread
+    void checkRetention()
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (!faceProcessor_ ||
+            now - lastRetentionCheck_ < chrono::milliseconds(NS_CLEANUP_INTERVAL))
+            return;
+        
+        lastRetentionCheck_ = now;
+        shared_ptr<Impl> me = shared_from_this();
+        faceProcessor_->dispatchSynchronized([me](shared_ptr<Face>){
+            me->expirePendingData();
+            me->enforceRetention();
+        });
+    }
+    
+    // adds object to (or refreshes it in) the list of retained objects and prunes the
+    // oldest ones if retention limits are exceeded; must be called on the Face thread
+    void retainObject(Namespace &objectNamespace, int64_t seqNo = -1)
+    {
+        RetainedObject o;
+        o.name_ = objectNamespace.getName();
+        o.seqNo_ = seqNo;
+        o.nPackets_ = 0;
+        o.nBytes_ = 0;
+        o.ts_ = chrono::steady_clock::now();
+        claimPendingData(o);
+        
+        string key = o.name_.toUri();
+        auto it = retainedIndex_.find(key);
+        if (it != retainedIndex_.end())
+        {
+            o.nPackets_ += it->second->nPackets_;
+            o.nBytes_ += it->second->nBytes_;
+            forgetObject(it->second);
+        }
+        retainedIndex_[key] = retainedObjects_.insert(retainedObjects_.end(), o);
+        totalPackets_ += o.nPackets_;
+        totalBytes_ += o.nBytes_;
+        
+        enforceRetention();
+    }
+    
+    // must be called on the Face thread
+    void addPendingData(const Data& d)
+    {
+        PendingData pd;
+        pd.nBytes_ = d.getDefaultWireEncoding().size();
+        pd.ts_ = chrono::steady_clock::now();
+        pendingData_.insert(make_pair(d.getName(), pd));
+    }
+    
+    // moves accounting of the pending packets under object's name to the object
+    void claimPendingData(RetainedObject& o)
+    {
+        // names under the object's prefix are adjacent in canonical order
+        auto it = pendingData_.lower_bound(o.name_);
+        while (it != pendingData_.end() && o.name_.isPrefixOf(it->first))
+        {
+            o.nPackets_++;
+            o.nBytes_ += it->second.nBytes_;
+            it = pendingData_.erase(it);
+        }
+    }
+    
+    // must be called on the Face thread
+    void expirePendingData()
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for (auto it = pendingData_.begin(); it != pendingData_.end(); )
+            if (now - it->second.ts_ > chrono::milliseconds(RETENTION_PENDING_TIMEOUT))
+                it = pendingData_.erase(it);
+            else
+                ++it;
+    }
+    
+    // must be called on the Face thread
+    void enforceRetention()
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        int nPruned = 0;
+        
+        // the latest object is never pruned, nor are objects still waiting in the playout
+        // buffer or currently on the output -- they would show up cleared
+        bool isPlayout = playout_.isEnabled();
+        int64_t playedSeqNo = (isPlayout ? playout_.getLastSeqNo() : -1);
+        while (retainedObjects_.size() > 1 && nPruned < RETENTION_PRUNE_MAX &&
+               (!isPlayout || retainedObjects_.front().seqNo_ < playedSeqNo) &&
+               isOverRetention(retainedObjects_.front(), now))
+        {
+            pruneObject(retainedObjects_.front().name_);
+            retainedIndex_.erase(retainedObjects_.front().name_.toUri());
+            forgetObject(retainedObjects_.begin());
+            nPruned++;
+        }
+        
+        prunedObjectsNum_ += nPruned;
+        updateRetentionStats();
+    }
+    
+    bool isOverRetention(const RetainedObject& oldest, const chrono::steady_clock::time_point& now)
+    {
+        return (retention_.maxObjects_ && retainedObjects_.size() > retention_.maxObjects_) ||
+               (retention_.maxBytes_ && totalBytes_ > retention_.maxBytes_) ||
+               (retention_.maxAgeMs_ && now - oldest.ts_ > chrono::milliseconds(retention_.maxAgeMs_));
+    }
+    
+    void pruneObject(const Name& objectName)
+    {
+        if (!namespace_)
+            return;
+        
+        if (namespace_->getName().equals(objectName))
+            namespace_->experimentalClear();
+        else if (namespace_->getName().isPrefixOf(objectName) && namespace_->hasChild(objectName))
+            namespace_->getChild(objectName).experimentalClear();
+    }
+    
+    void forgetObject(list<RetainedObject>::iterator it)
+    {
+        totalPackets_ -= it->nPackets_;
+        totalBytes_ -= it->nBytes_;
+        retainedObjects_.erase(it);
+    }
+    
+    void updateRetentionStats()
+    {
+        retainedObjectsNum_ = (int64_t)retainedObjects_.size();
+        retainedPacketsNum_ = totalPackets_;
+        retainedBytes_ = totalBytes_;
+        namespaceMemory_.set(totalBytes_);
+    }
+    
+    // moves next due object from the playout buffer to the output
+    void releasePlayout()
+    {
+        PlayoutBuffer::Entry e;
+        if (playout_.release(e))
+            setSnapshot(e.snapshot_);
+    }
+    
+    vector<pair<string,string>> datInfoFromSnapshot(const shared_ptr<const ObjectSnapshot> &p)
     {
         vector<pair<string,string>> rows;
-        if (p.isObjectReady())
+        if (p && p->isObjectReady())
         {
-            rows.push_back(pair<string,string>("Object Namespace", p.namespaceData_.objectNamespaceName_
-                                               ));
-            if (p.contentMetaInfo_)
+            rows.push_back(pair<string,string>("Object Namespace", p->objectName_.toUri()));
+            if (p->contentMetaInfo_)
             {
-                rows.push_back(pair<string,string>("Content-Type", p.contentMetaInfo_->getContentType()));
-                rows.push_back(pair<string,string>("Timestamp", to_string(p.contentMetaInfo_->getTimestamp())));
-                rows.push_back(pair<string,string>("Other", p.contentMetaInfo_->getOther().toRawStr()));
+                rows.push_back(pair<string,string>("Content-Type", p->contentMetaInfo_->getContentType()));
+                rows.push_back(pair<string,string>("Timestamp", to_string(p->contentMetaInfo_->getTimestamp())));
+                rows.push_back(pair<string,string>("Other", p->contentMetaInfo_->getOther().toRawStr()));
             }
-            if (p.fetchedNum_ > 0)
+            if (fetchedNum_ > 0)
             {
-                rows.push_back(pair<string,string>("GObjStream SeqNo", to_string(p.seqNo_)));
-                rows.push_back(pair<string,string>("GObjStream Fetched Total", to_string(p.fetchedNum_)));
+                rows.push_back(pair<string,string>("GObjStream SeqNo", to_string(p->seqNo_)));
+                rows.push_back(pair<string,string>("GObjStream Fetched Total", to_string(fetchedNum_)));
             }
             
-            rows.push_back(pair<string,string>("Total Packets", to_string(p.namespaceData_.allPackets_.size())));
-            int idx = 0;
-            for (auto &d: p.namespaceData_.allPackets_)
-                rows.push_back(pair<string,string>("Packet "+to_string(idx++), d->getName().toUri()));
+            shared_ptr<const ObjectSnapshot::PacketNames> packetNames = requestPacketNames(p);
+            if (packetNames)
+            {
+                rows.push_back(pair<string,string>("Total Packets", to_string(packetNames->size())));
+                int idx = 0;
+                for (auto &n: *packetNames)
+                    rows.push_back(pair<string,string>("Packet "+to_string(idx++), n));
+            }
+            else
+                rows.push_back(pair<string,string>("Total Packets", "..."));
         }
         return rows;
     }
@@ -634,14 +1198,26 @@ NamespaceDAT::NamespaceDAT(const OP_NodeInfo* info)
 , mustBeFresh_(true)
 , produceOnRequest_(false)
 , gobjVersioned_(false)
+, gobjStreamOnDemand_(false)
+, stagedInputVersion_(0)
+, publishedInputVersion_(0)
+, skipUnchanged_(true)
+, skippedInputsNum_(0)
+, skippedPublishesNum_(0)
 , datInputData_(make_shared<DatInputData>())
-, pimpl_(make_shared<Impl>(logger_, HandlerType::GObj))
+, pimpl_(make_shared<Impl>(logger_, HandlerType::GObj, retention_, trackMemory("namespace")))
 , pipeline_(10)
+, playoutSize_(0)
+, playoutMode_(PlayoutMode::Cook)
 {
     datInputData_->handlerType_ = pimpl_->handlerType_;
     datInputData_->inputFile_ = "";
     datInputData_->contentType_ = "text/html";
     datInputData_->metaInfo_ = make_shared<MetaInfo>();
+    datInputData_->version_ = 0;
+    datInputData_->payloadHash_ = 0;
+    datInputData_->payloadTop_ = nullptr;
+    datInputData_->payloadTopVersion_ = 0;
   
     OPLOG_DEBUG("Created NamespaceDAT");
 }
@@ -655,7 +1231,8 @@ NamespaceDAT::~NamespaceDAT()
 void
 NamespaceDAT::getGeneralInfo(DAT_GeneralInfo *ginfo, const OP_Inputs *inputs, void *reserved1)
 {
-    ginfo->cookEveryFrame = false;
+    // playout buffer releases objects at a steady pace, hence needs regular cooks
+    ginfo->cookEveryFrame = (playoutSize_ > 0 && pimpl_->handlerType_ == HandlerType::GObjStream);
     // has to be true, because otherwise the OP isn't cooking enough to run its logic
     ginfo->cookEveryFrameIfAsked = true;
 }
@@ -669,10 +1246,17 @@ NamespaceDAT::execute(DAT_Output* output,
     
     if (!pimpl_->namespace_)
         initNamespace(output, inputs, reserved);
+    else if (pimpl_->faceRecovered_.exchange(false))
+        pimpl_->recoverFace();
     
     if (pimpl_->namespace_ && pimpl_->namespace_->getFace_())
     {
         bool isFetching = !isProducer(inputs);
+        
+        if (isFetching && pimpl_->playout_.isEnabled())
+            pimpl_->releasePlayout();
+        pimpl_->checkRetention();
+        
         switch (pimpl_->namespace_->getState()) {
             case NamespaceState_NAME_EXISTS:
             {
@@ -688,6 +1272,8 @@ NamespaceDAT::execute(DAT_Output* output,
                     if (produceNow)
                         // active producer
                         runPublish(output, inputs, reserved);
+                    else if (gobjStreamOnDemand_ && pimpl_->handlerType_ == HandlerType::GObjStream)
+                        runStage(output, inputs, reserved);
                 }
             }
                 break;
@@ -705,30 +1291,87 @@ NamespaceDAT::execute(DAT_Output* output,
     setOutput(output, inputs, reserved);
 }
 
+int32_t
+NamespaceDAT::getNumInfoCHOPChans(void* reserved1)
+{
+    return BaseDAT::getNumInfoCHOPChans(reserved1) + (int32_t)ChanNames.size();
+}
+
+void
+NamespaceDAT::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
+{
+    NamespaceDAT::InfoChopIndex idx = (NamespaceDAT::InfoChopIndex)index;
+    
+    if (index < ChanNames.size())
+    {
+        chan->name->setString(ChanNames.at(idx).c_str());
+        
+        switch (idx) {
+            case NamespaceDAT::InfoChopIndex::PlayoutDepth:
+                chan->value = (float)pimpl_->playout_.getDepth();
+                break;
+            case NamespaceDAT::InfoChopIndex::PlayoutUnderruns:
+                chan->value = (float)pimpl_->playout_.getUnderruns();
+                break;
+            case NamespaceDAT::InfoChopIndex::PlayoutReleased:
+                chan->value = (float)pimpl_->playout_.getReleased();
+                break;
+            case NamespaceDAT::InfoChopIndex::PlayoutDropped:
+                chan->value = (float)pimpl_->playout_.getDropped();
+                break;
+            case NamespaceDAT::InfoChopIndex::RetainedObjects:
+                chan->value = (float)pimpl_->retainedObjectsNum_;
+                break;
+            case NamespaceDAT::InfoChopIndex::RetainedPackets:
+                chan->value = (float)pimpl_->retainedPacketsNum_;
+                break;
+            case NamespaceDAT::InfoChopIndex::RetainedBytes:
+                chan->value = (float)pimpl_->retainedBytes_;
+                break;
+            case NamespaceDAT::InfoChopIndex::PrunedObjects:
+                chan->value = (float)pimpl_->prunedObjectsNum_;
+                break;
+            case NamespaceDAT::InfoChopIndex::SkippedInputs:
+                chan->value = (float)skippedInputsNum_;
+                break;
+            case NamespaceDAT::InfoChopIndex::SkippedPublishes:
+                chan->value = (float)skippedPublishesNum_;
+                break;
+            default:
+                chan->value = 0;
+                break;
+        }
+    }
+    else
+        BaseDAT::getInfoCHOPChan(index - (int32_t)ChanNames.size(), chan, reserved1);
+}
+
 void
 NamespaceDAT::setOutput(DAT_Output *output, const OP_Inputs* inputs, void* reserved)
 {
-    if (pimpl_->getIsObjectReady())
+    shared_ptr<const Impl::ObjectSnapshot> snapshot = pimpl_->getSnapshot();
+    
+    if (snapshot && snapshot->isObjectReady())
     {
-        if (!pimpl_->objectReadyPayload_.readTs_)//!outputString_.size() || pimpl_->handlerType_ == HandlerType::GObjStream)
-            if (!pimpl_->tryLockObjectReady([&](Impl::ObjectReadyPayload &p)
-                {
-                    shared_ptr<BlobObject> b = dynamic_pointer_cast<BlobObject>(p.object_);
-                    if (b)
-                    {
-                        p.readTs_ = ndn_getNowMilliseconds();
-                        clearError();
-                        outputString_ = rawOutput_ ? b->toRawStr() : BaseDAT::toBase64(*b->getBlob());
-                    }
-                    else
-                    {
-                        setError("Failed to process received object");
-                        OPLOG_ERROR("Failed to cast received Object to BlobObject");
-                    }
-                }))
+        // only re-encode output when a new object has been published
+        if (snapshot != pimpl_->outputSnapshot_)
+        {
+            shared_ptr<BlobObject> b = dynamic_pointer_cast<BlobObject>(snapshot->object_);
+            if (b)
             {
-                OPLOG_WARN("object is locked");
+                clearError();
+                if (rawOutput_)
+                    outputString_ = b->toRawStr();
+                else
+                    BaseDAT::toBase64(*b->getBlob(), outputString_);
             }
+            else
+            {
+                setError("Failed to process received object");
+                OPLOG_ERROR("Failed to cast received Object to BlobObject");
+            }
+            pimpl_->outputSnapshot_ = snapshot;
+        }
         
         output->setText(outputString_.c_str());
         
@@ -742,73 +1385,69 @@ NamespaceDAT::setOutput(DAT_Output *output, const OP_Inputs* inputs, void* reser
 void
 NamespaceDAT::storeOutput(DAT_Output *output, const OP_Inputs *inputs, void *reserved)
 {
-    bool storePayload = (!isProducer(inputs) && payloadOutput_.size()) && (!payloadStored_ ||
-                            pimpl_->handlerType_ == HandlerType::GObjStream);
+    shared_ptr<const Impl::ObjectSnapshot> snapshot = pimpl_->getSnapshot();
+    bool storePayload = (!isProducer(inputs) && payloadOutput_.size()) &&
+                        (!payloadStored_ || snapshot != pimpl_->storedSnapshot_);
     
-    if (pimpl_->getIsObjectReady() &&
+    if (snapshot && snapshot->isObjectReady() &&
         storePayload)
     {
-        if (!pimpl_->tryLockObjectReady([&](Impl::ObjectReadyPayload &p)
+        pimpl_->storedSnapshot_ = snapshot;
+        
+        shared_ptr<BlobObject> b = dynamic_pointer_cast<BlobObject>(snapshot->object_);
+        if (!b)
         {
-            shared_ptr<BlobObject> b = dynamic_pointer_cast<BlobObject>(p.object_);
-            if (!b)
-            {
-                OPLOG_ERROR("Failed to cast received Object to BlobObject");
-                return;
-            }
-            p.readTs_ = ndn_getNowMilliseconds();
-            
-            if (retrieveOp(getCanonical(payloadOutput_)))
+            OPLOG_ERROR("Failed to cast received Object to BlobObject");
+            return;
+        }
+        
+        if (retrieveOp(getCanonical(payloadOutput_)))
+        {
+            // save to TOP
+            PayloadTOP *payloadTOP = (PayloadTOP*)retrieveOp(getCanonical(payloadOutput_));
+            assert(payloadTOP);
+            if (snapshot->contentMetaInfo_)
             {
-                // save to TOP
-                PayloadTOP *payloadTOP = (PayloadTOP*)retrieveOp(getCanonical(payloadOutput_));
-                assert(payloadTOP);
-                if (p.contentMetaInfo_)
+                string jsonErr;
+                json11::Json json = json11::Json::parse(snapshot->contentMetaInfo_->getOther().toRawStr(), jsonErr);
+                if (jsonErr.size() == 0)
                 {
-                    string jsonErr;
-                    json11::Json json = json11::Json::parse(p.contentMetaInfo_->getOther().toRawStr(), jsonErr);
-                    if (jsonErr.size() == 0)
-                    {
-                        int w = json["width"].int_value();
-                        int h = json["height"].int_value();
-                        
-                        clearError();
-                        payloadTOP->setBuffer(*b->getBlob(), w, h);
-                        payloadStored_ = true;
-                    }
-                    else
-                    {
-                        setError("Error processing received object");
-                        OPLOG_ERROR("Received ContentMetaInfo is a bad JSON");
-                    }
+                    int w = json["width"].int_value();
+                    int h = json["height"].int_value();
+                    
+                    clearError();
+                    payloadTOP->setBuffer(*b->getBlob(), w, h);
+                    payloadStored_ = true;
+                }
+                else
+                {
+                    setError("Error processing received object");
+                    OPLOG_ERROR("Received ContentMetaInfo is a bad JSON");
                 }
             }
-            else // save to a file
+        }
+        else // save to a file
+        {
+            ofstream file(payloadOutput_, ios_base::out | ios_base::binary);
+            if (file)
             {
-                ofstream file(payloadOutput_, ios_base::out | ios_base::binary);
-                if (file)
+                file.write((const char*)b->getBlob().buf(), b->getBlob().size());
+                if (!file)
                 {
-                    file.write((const char*)b->getBlob().buf(), b->getBlob().size());
-                    if (!file)
-                    {
-                        setError("Unable to write to file %s", payloadOutput_.c_str());
-                        OPLOG_ERROR("Failed to write to file {}", payloadOutput_);
-                    }
-                    else
-                    {
-                        clearError();
-                        payloadStored_ = true;
-                    }
+                    setError("Unable to write to file %s", payloadOutput_.c_str());
+                    OPLOG_ERROR("Failed to write to file {}", payloadOutput_);
                 }
                 else
                 {
-                    setError("Unable to open file %s", payloadOutput_.c_str());
-                    OPLOG_ERROR("Failed to open file {}", payloadOutput_);
+                    clearError();
+                    payloadStored_ = true;
                 }
             }
-        }))
-        {
-            OPLOG_WARN("object is locked");
+            else
+            {
+                setError("Unable to open file %s", payloadOutput_.c_str());
+                OPLOG_ERROR("Failed to open file {}", payloadOutput_);
+            }
         }
     }
 }
@@ -821,6 +1460,7 @@ NamespaceDAT::copyDatInputData(DAT_Output *output, const OP_Inputs *inputs, void
     unique_lock<recursive_mutex> lock(datInputData_->mtx_, try_to_lock);
     if (lock.owns_lock())
     {
+        string inputFile = datInputData_->inputFile_;
         datInputData_->inputFile_ = "";
         datInputData_->handlerType_ = pimpl_->handlerType_;
         datInputData_->metaInfo_->setFreshnessPeriod(freshness_);
@@ -832,9 +1472,27 @@ NamespaceDAT::copyDatInputData(DAT_Output *output, const OP_Inputs *inputs, void
                 // got nothing
                 return ;
             
-            datInputData_->contentType_ = (datInput->isTable && datInput->numRows > 1 ? datInput->getCell(1, 0) : "text/html");
-            datInputData_->payload_ = make_shared<Blob>(Blob::fromRawStr(datInput->getCell(0, 0)));
-            datInputData_->other_.reset();
+            const char *contentType = (datInput->isTable && datInput->numRows > 1 ? datInput->getCell(1, 0) : "text/html");
+            const char *cell = datInput->getCell(0, 0);
+            size_t len = strlen(cell);
+            uint64_t hash = contentHash(cell, len);
+            shared_ptr<Blob> &payload = datInputData_->payload_;
+            bool changed = !payload || payload->size() != len ||
+                           hash != datInputData_->payloadHash_ ||
+                           datInputData_->contentType_ != contentType ||
+                           datInputData_->other_ || inputFile.size();
+            
+            if (changed)
+            {
+                datInputData_->contentType_ = contentType;
+                datInputData_->payload_ = make_shared<Blob>((const uint8_t*)cell, len);
+                datInputData_->payloadHash_ = hash;
+                datInputData_->payloadTop_ = nullptr;
+                datInputData_->other_.reset();
+                datInputData_->version_++;
+            }
+            else
+                skippedInputsNum_++;
         }
         else
         {
@@ -844,8 +1502,18 @@ NamespaceDAT::copyDatInputData(DAT_Output *output, const OP_Inputs *inputs, void
             {
                 // load payload from the TOP
                 PayloadTOP *payloadTop = (PayloadTOP*)retrieveOp(getCanonical(payloadInput_));
+                // PayloadTOP bumps buffer version only when its content changes
+                if (payloadTop == datInputData_->payloadTop_ &&
+                    payloadTop->getBufferVersion() == datInputData_->payloadTopVersion_)
+                {
+                    skippedInputsNum_++;
+                    return;
+                }
+                
                 int size, w, h;
                 shared_ptr<vector<uint8_t>> buffer = payloadTop->getBuffer(size, w, h);
+                datInputData_->payloadTop_ = payloadTop;
+                datInputData_->payloadTopVersion_ = payloadTop->getBufferVersion();
                 datInputData_->contentType_ = "image/x-bgra";
                 
                 json11::Json json = json11::Json::object {
@@ -855,9 +1523,15 @@ NamespaceDAT::copyDatInputData(DAT_Output *output, const OP_Inputs *inputs, void
                 };
                 datInputData_->other_ = make_shared<Blob>(Blob::fromRawStr(json.dump()));
                 datInputData_->payload_ = make_shared<Blob>(buffer);
+                datInputData_->version_++;
             }
             else
+            {
+                datInputData_->payloadTop_ = nullptr;
                 datInputData_->inputFile_ = payloadInput_;
+                if (inputFile != payloadInput_)
+                    datInputData_->version_++;
+            }
         }
     }
     else
@@ -921,12 +1595,19 @@ NamespaceDAT::initNamespace(DAT_Output*output, const OP_Inputs* inputs, void* re
         clearError();
         payloadStored_ = false;
         HandlerType ht = pimpl_->handlerType_;
-        pimpl_ = make_shared<Impl>(logger_, ht);
+        pimpl_ = make_shared<Impl>(logger_, ht, retention_, trackMemory("namespace"));
         pimpl_->initNamespace(prefix_, keyChain, getFaceDatOp()->getFaceProcessor());
         
         if (isProducer)
         {
-            if (produceOnRequest_ ||
+            publishedInputVersion_ = 0;
+            
+            if (gobjStreamOnDemand_ && pimpl_->handlerType_ == HandlerType::GObjStream)
+            {
+                stagedInputVersion_ = 0;
+                pimpl_->produceOnInterest();
+            }
+            else if (produceOnRequest_ ||
                 (gobjVersioned_ && pimpl_->handlerType_ == HandlerType::GObj))
             {
                 bool versioned = (gobjVersioned_ && pimpl_->handlerType_ == HandlerType::GObj);
@@ -968,6 +1649,19 @@ NamespaceDAT::runPublish(DAT_Output *output, const OP_Inputs *inputs, void *rese
         clearWarning();
         clearError();
         
+        // stream objects are published under new names every time, skip those if input
+        // hasn't changed since the last publish
+        if (pimpl_->handlerType_ == HandlerType::GObjStream)
+        {
+            if (skipUnchanged_ && datInputData_->version_ == publishedInputVersion_ &&
+                datInputData_->inputFile_.size() == 0)
+            {
+                skippedPublishesNum_++;
+                return;
+            }
+            publishedInputVersion_ = datInputData_->version_;
+        }
+        
         shared_ptr<Impl> pimpl = pimpl_;
         shared_ptr<Namespace> n = pimpl_->namespace_;
         shared_ptr<Impl::PayloadData> pd = Impl::PayloadData::fromDatInputData(datInputData_);
@@ -982,10 +1676,43 @@ NamespaceDAT::runPublish(DAT_Output *output, const OP_Inputs *inputs, void *rese
         OPLOG_WARN("data is locked");
 }
 
+void
+NamespaceDAT::runStage(DAT_Output *output, const OP_Inputs *inputs, void *reserved)
+{
+    unique_lock<recursive_mutex> lock(datInputData_->mtx_, try_to_lock);
+    if (lock.owns_lock())
+    {
+        if (datInputData_->version_ == stagedInputVersion_)
+            return;
+        
+        if ((!datInputData_->payload_ || datInputData_->payload_->size() == 0) && datInputData_->inputFile_.size() == 0)
+        {
+            setWarning("Can't read input. Not publishing");
+            return;
+        }
+        
+        clearWarning();
+        clearError();
+        
+        stagedInputVersion_ = datInputData_->version_;
+        shared_ptr<Impl> pimpl = pimpl_;
+        shared_ptr<Impl::PayloadData> pd = Impl::PayloadData::fromDatInputData(datInputData_);
+        // payload is prepared here, segmenting and signing happens on the Face thread once
+        // there's demand for the next sequence number
+        getFaceDatOp()->getFaceProcessor()->dispatchSynchronized([pimpl,pd](shared_ptr<Face> f){
+            pimpl->stage(pd);
+        });
+    }
+}
+
 void
 NamespaceDAT::runFetch(DAT_Output *output, const OP_Inputs *inputs, void *reserved)
 {
-    pimpl_->fetch(mustBeFresh_, gobjVersioned_, pipeline_);
+    bool playout = (pimpl_->handlerType_ == HandlerType::GObjStream && playoutSize_ > 0);
+    if (!pimpl_->resumeFetch_)
+        pimpl_->playout_.configure(playout ? playoutSize_ : 0, playoutMode_);
+    // prefetch at least as many objects as the playout buffer holds
+    pimpl_->fetch(mustBeFresh_, gobjVersioned_, max(pipeline_, playout ? playoutSize_ : 0));
     outputString_ = "";
     payloadStored_ = false;
 }
@@ -996,10 +1723,7 @@ NamespaceDAT::getInfoDATSize(OP_InfoDATSize* infoSize, void* reserved1)
 {
     BaseDAT::getInfoDATSize(infoSize, reserved1);
     
-    pimpl_->tryLockObjectReady([this](const Impl::ObjectReadyPayload &p){
-        payloadInfoRows_.clear();
-        payloadInfoRows_ = Impl::datInfoFromObjectPayload(p);
-    });
+    payloadInfoRows_ = pimpl_->datInfoFromSnapshot(pimpl_->getSnapshot());
     
     size_t packetsRow = payloadInfoRows_.size();
     int nDefaultRows = NDEFAULT_ROWS;
@@ -1137,6 +1861,20 @@ NamespaceDAT::setupParameters(OP_ParameterManager* manager, void* reserved1)
          return manager->appendPulse(p);
      });
     
+    appendPar<OP_NumericParameter>
+    (manager, PAR_GOBJ_STREAM_ONDEMAND, PAR_GOBJ_STREAM_ONDEMAND_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = gobjStreamOnDemand_;
+         return manager->appendToggle(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_SKIP_UNCHANGED, PAR_SKIP_UNCHANGED_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = skipUnchanged_;
+         return manager->appendToggle(p);
+     });
+    
     appendPar<OP_NumericParameter>
     (manager, PAR_GOBJ_STREAM_PP, PAR_GOBJ_STREAM_PP_LABEL, PAR_PAGE_DEFAULT,
      [&](OP_NumericParameter &p){
@@ -1154,12 +1892,73 @@ NamespaceDAT::setupParameters(OP_ParameterManager* manager, void* reserved1)
          return manager->appendInt(p);
      });
     
+    appendPar<OP_NumericParameter>
+    (manager, PAR_PLAYOUT_SIZE, PAR_PLAYOUT_SIZE_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = playoutSize_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 60;
+         p.minSliders[0] = p.minValues[0];
+         p.maxSliders[0] = p.maxValues[0];
+         return manager->appendInt(p);
+     });
+    
+#define PAR_PLAYOUT_MENU_SIZE 2
+    static const char *playoutNames[PAR_PLAYOUT_MENU_SIZE] = {
+        PAR_PLAYOUT_COOK,
+        PAR_PLAYOUT_TIMESTAMP
+    };
+    static const char *playoutLabels[PAR_PLAYOUT_MENU_SIZE] = {
+        PAR_PLAYOUT_COOK_LABEL,
+        PAR_PLAYOUT_TIMESTAMP_LABEL
+    };
+    
+    appendPar<OP_StringParameter>
+    (manager, PAR_PLAYOUT_MODE, PAR_PLAYOUT_MODE_LABEL, PAR_PAGE_DEFAULT,
+     [&](OP_StringParameter &p){
+         p.defaultValue = PAR_PLAYOUT_COOK;
+         return manager->appendMenu(p, PAR_PLAYOUT_MENU_SIZE, playoutNames, playoutLabels);
+     });
+    
 //    appendPar<OP_NumericParameter>
 //    (manager, PAR_GOBJ_STREAM_SEQ_PULSE, PAR_GOBJ_STREAM_SEQ_PULSE_LABEL, PAR_PAGE_DEFAULT,
 //     [&](OP_NumericParameter &p){
 //         return manager->appendToggle(p);
 //     });
     
+    appendPar<OP_NumericParameter>
+    (manager, PAR_RETAIN_OBJECTS, PAR_RETAIN_OBJECTS_LABEL, PAR_PAGE_RETENTION,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = retention_.maxObjects_;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 100000;
+         p.minSliders[0] = p.minValues[0];
+         p.maxSliders[0] = 1000;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_RETAIN_SIZE, PAR_RETAIN_SIZE_LABEL, PAR_PAGE_RETENTION,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = 0;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 16384;
+         p.minSliders[0] = p.minValues[0];
+         p.maxSliders[0] = 1024;
+         return manager->appendInt(p);
+     });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_RETAIN_AGE, PAR_RETAIN_AGE_LABEL, PAR_PAGE_RETENTION,
+     [&](OP_NumericParameter &p){
+         p.defaultValues[0] = 0;
+         p.minValues[0] = 0;
+         p.maxValues[0] = 24*3600;
+         p.minSliders[0] = p.minValues[0];
+         p.maxSliders[0] = 600;
+         return manager->appendInt(p);
+     });
+    
     appendPar<OP_StringParameter>
     (manager, PAR_INPUT, PAR_INPUT_LABEL, PAR_PAGE_DEFAULT,
      [&](OP_StringParameter &p){
@@ -1208,9 +2007,30 @@ NamespaceDAT::checkParams(DAT_Output*, const OP_Inputs* inputs, void* reserved)
     updateIfNew<HandlerType>
     (PAR_HANDLER_TYPE, pimpl_->handlerType_, HandlerTypeMap.at(inputs->getParString(PAR_HANDLER_TYPE)));
     
+    updateIfNew<uint32_t>
+    (PAR_PLAYOUT_SIZE, playoutSize_, inputs->getParInt(PAR_PLAYOUT_SIZE));
+    
+    updateIfNew<PlayoutMode>
+    (PAR_PLAYOUT_MODE, playoutMode_, PlayoutModeMap.at(inputs->getParString(PAR_PLAYOUT_MODE)));
+    
     updateIfNew<bool>
     (PAR_GOBJ_VERSIONED, gobjVersioned_, (bool)inputs->getParInt(PAR_GOBJ_VERSIONED));
     
+    updateIfNew<bool>
+    (PAR_GOBJ_STREAM_ONDEMAND, gobjStreamOnDemand_, (bool)inputs->getParInt(PAR_GOBJ_STREAM_ONDEMAND));
+    
+    updateIfNew<bool>
+    (PAR_SKIP_UNCHANGED, skipUnchanged_, (bool)inputs->getParInt(PAR_SKIP_UNCHANGED));
+    
+    updateIfNew<uint32_t>
+    (PAR_RETAIN_OBJECTS, retention_.maxObjects_, inputs->getParInt(PAR_RETAIN_OBJECTS));
+    
+    updateIfNew<int64_t>
+    (PAR_RETAIN_SIZE, retention_.maxBytes_, (int64_t)inputs->getParInt(PAR_RETAIN_SIZE) << 20);
+    
+    updateIfNew<uint32_t>
+    (PAR_RETAIN_AGE, retention_.maxAgeMs_, inputs->getParInt(PAR_RETAIN_AGE)*1000);
+    
     updateIfNew<string>
     (PAR_INPUT, payloadInput_, inputs->getParString(PAR_INPUT));
     
@@ -1225,9 +2045,13 @@ NamespaceDAT::checkParams(DAT_Output*, const OP_Inputs* inputs, void* reserved)
     bool isProducing = isProducer(inputs);
     inputs->enablePar(PAR_GOBJ_STREAM_PULSE, pimpl_->handlerType_ == HandlerType::GObjStream && isProducing);
     inputs->enablePar(PAR_GOBJ_STREAM_SEQ, pimpl_->handlerType_ == HandlerType::GObjStream && isProducing);
+    inputs->enablePar(PAR_GOBJ_STREAM_ONDEMAND, pimpl_->handlerType_ == HandlerType::GObjStream && isProducing);
+    inputs->enablePar(PAR_SKIP_UNCHANGED, pimpl_->handlerType_ == HandlerType::GObjStream && isProducing);
 //    inputs->enablePar(PAR_GOBJ_STREAM_PULSE, pimpl_->handlerType_ == HandlerType::GObjStream && isProducing);
     inputs->enablePar(PAR_FRESHNESS, isProducing);
     inputs->enablePar(PAR_OUTPUT, !isProducing);
+    inputs->enablePar(PAR_PLAYOUT_SIZE, pimpl_->handlerType_ == HandlerType::GObjStream && !isProducing);
+    inputs->enablePar(PAR_PLAYOUT_MODE, pimpl_->handlerType_ == HandlerType::GObjStream && !isProducing);
 //    inputs->enablePar(PAR_INPUT, isProducing);
 }
 
@@ -1238,6 +2062,26 @@ NamespaceDAT::paramsUpdated()
         dispatchOnExecute(bind(&NamespaceDAT::initNamespace, this, _1, _2, _3));
     });
     
+    runIfUpdated(PAR_GOBJ_STREAM_ONDEMAND, [this](){
+        if (pimpl_->handlerType_ == HandlerType::GObjStream)
+            dispatchOnExecute(bind(&NamespaceDAT::initNamespace, this, _1, _2, _3));
+    });
+    
+    runIfUpdated(PAR_PLAYOUT_SIZE, [this](){
+        // pipeline size depends on playout buffer size, hence re-create the stream handler
+        if (pimpl_->handlerType_ == HandlerType::GObjStream && pimpl_->namespace_)
+            dispatchOnExecute(bind(&NamespaceDAT::initNamespace, this, _1, _2, _3));
+    });
+    
+    runIfUpdatedAny({PAR_RETAIN_OBJECTS, PAR_RETAIN_SIZE, PAR_RETAIN_AGE}, [this](){
+        pimpl_->setRetentionPolicy(retention_);
+    });
+    
+    runIfUpdated(PAR_PLAYOUT_MODE, [this](){
+        if (pimpl_->playout_.isEnabled())
+            pimpl_->playout_.configure(playoutSize_, playoutMode_);
+    });
+    
     runIfUpdated(PAR_FACEDAT, [this](){
         dispatchOnExecute([this](DAT_Output*, const OP_Inputs* inputs, void* reserved){
             pairOp(faceDat_, true);
@@ -1256,6 +2100,7 @@ NamespaceDAT::paramsUpdated()
     
     runIfUpdated(PAR_RAWOUTPUT, [this](){
         outputString_ = "";
+        pimpl_->outputSnapshot_.reset();
         if (pimpl_->getIsObjectReady())
             dispatchOnExecute(bind(&NamespaceDAT::setOutput, this, _1, _2, _3));
     });
@@ -19,6 +19,7 @@
  */
 
 #include <string>
+#include <map>
 #include <atomic>
 #include <mutex>
 
@@ -56,11 +57,45 @@ public:
         GObjStream
     };
     
+    enum class PlayoutMode : int32_t {
+        Cook,
+        Timestamp
+    };
+    
+    enum class InfoChopIndex : int32_t {
+        PlayoutDepth,
+        PlayoutUnderruns,
+        PlayoutReleased,
+        PlayoutDropped,
+        RetainedObjects,
+        RetainedPackets,
+        RetainedBytes,
+        PrunedObjects,
+        SkippedInputs,
+        SkippedPublishes
+    };
+    
+    // Limits for objects kept in the Namespace tree (published or fetched); oldest objects
+    // are pruned once any of the limits is exceeded. 0 means no limit.
+    typedef struct _RetentionPolicy {
+        _RetentionPolicy(): maxObjects_(100), maxBytes_(0), maxAgeMs_(0) {}
+        
+        uint32_t maxObjects_;
+        int64_t maxBytes_;
+        uint32_t maxAgeMs_;
+    } RetentionPolicy;
+    
+    static const std::map<InfoChopIndex, std::string> ChanNames;
+    
 	NamespaceDAT(const OP_NodeInfo* info);
 	virtual ~NamespaceDAT();
 
     virtual void getGeneralInfo(DAT_GeneralInfo *ginfo, const OP_Inputs *inputs, void *reserved1) override;
 	virtual void execute(DAT_Output*, const OP_Inputs*, void* reserved) override;
+    virtual int32_t     getNumInfoCHOPChans(void* reserved1) override;
+    virtual void        getInfoCHOPChan(int index,
+                                        OP_InfoCHOPChan* chan,
+                                        void* reserved1) override;
     virtual bool        getInfoDATSize(OP_InfoDATSize* infoSize, void* reserved1) override;
     virtual void        getInfoDATEntries(int32_t index,
                                             int32_t nEntries,
@@ -71,9 +106,15 @@ public:
 	virtual void		pulsePressed(const char* name, void* reserved1) override;
 
 private:
-    uint32_t freshness_, pipeline_;
+    uint32_t freshness_, pipeline_, playoutSize_;
+    PlayoutMode playoutMode_;
+    RetentionPolicy retention_;
     std::string prefix_, faceDat_, keyChainDat_, payloadInput_, payloadOutput_;
-    bool rawOutput_, payloadStored_, mustBeFresh_, produceOnRequest_, gobjVersioned_;
+    bool rawOutput_, payloadStored_, mustBeFresh_, produceOnRequest_, gobjVersioned_, gobjStreamOnDemand_;
+    uint64_t stagedInputVersion_, publishedInputVersion_;
+    // skip publishing stream objects if input hasn't changed
+    bool skipUnchanged_;
+    uint64_t skippedInputsNum_, skippedPublishesNum_;
     std::string outputString_;
     std::vector<std::pair<std::string, std::string>> payloadInfoRows_;
     
@@ -83,6 +124,13 @@ private:
         std::string inputFile_, contentType_;
         std::shared_ptr<ndn::MetaInfo> metaInfo_;
         std::shared_ptr<ndn::Blob> payload_, other_;
+        // hash of DAT input payload
+        uint64_t payloadHash_;
+        // PayloadTOP the payload was taken from, and its buffer version
+        const void *payloadTop_;
+        uint64_t payloadTopVersion_;
+        // incremented every time input content changes
+        uint64_t version_;
     } DatInputData;
     std::shared_ptr<DatInputData> datInputData_;
     
@@ -103,6 +151,8 @@ private:
     KeyChainDAT *getKeyChainDatOp() { return (KeyChainDAT*)getPairedOp(keyChainDat_); }
 
     void runPublish(DAT_Output*output, const OP_Inputs* inputs, void* reserved);
+    // hands over new input to the Interest-driven GObjStream producer
+    void runStage(DAT_Output*output, const OP_Inputs* inputs, void* reserved);
     void runFetch(DAT_Output*output, const OP_Inputs* inputs, void* reserved);
     void setOutput(DAT_Output *output, const OP_Inputs* inputs, void* reserved);
     void storeOutput(DAT_Output *output, const OP_Inputs* inputs, void* reserved);
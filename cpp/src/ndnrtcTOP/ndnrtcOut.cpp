@@ -20,19 +20,29 @@
 
 #include "ndnrtcOut.hpp"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #define GL_SILENCE_DEPRECATION
 #include <OpenGL/gl3.h>
 #include <ndnrtc/stream.hpp>
 #include <ndnrtc/name-components.hpp>
 #include <ndn-cpp/threadsafe-face.hpp>
 #include <ndn-cpp/security/key-chain.hpp>
-#include <ndn-cpp/util/memory-content-cache.hpp>
 #include <libyuv.h>
 
 #include "faceDat.h"
 #include "keyChainDAT.h"
 #include "face-processor.hpp"
 #include "key-chain-manager.hpp"
+#include "common/contrib/json11/json11.hpp"
 
 #define MODULE_LOGGER "ndnrtcTOP"
 
@@ -52,6 +62,14 @@ default:
 }
 
 #define BASE_PREFIX "/touchdesigner"
+#define JOIN_META_COMPONENT "_join"
+// stream re-created by the rate controller (opt-in) is published under "<name>-v<N>"
+#define STREAM_VERSION_SEPARATOR "-v"
+#define JOIN_META_FRESHNESS_MS 100
+#define PENDING_INTERESTS_MAX 1024
+#define PENDING_FRAMES_AHEAD 30
+#define PENDING_SWEEP_MS 100
+#define DEFAULT_INTEREST_LIFETIME_MS 4000
 
 #define PAR_FACEOP "Faceop"
 #define PAR_FACEOP_LABEL "Face"
@@ -67,6 +85,34 @@ default:
 #define PAR_SEGSIZE_LABEL "Segment Size"
 #define PAR_GOP_SIZE "Gopsize"
 #define PAR_GOP_SIZE_LABEL "GOP Size"
+#define PAR_CACHE_LENGTH "Cachelength"
+#define PAR_CACHE_LENGTH_LABEL "Cache Length (ms)"
+#define PAR_CACHE_SIZE "Cachesize"
+#define PAR_CACHE_SIZE_LABEL "Cache Size (MB)"
+#define PAR_LAYERS "Layers"
+#define PAR_LAYERS_LABEL "Simulcast Layers"
+
+#define LAYERS_MAX 4
+#define LAYER_BITRATE_MIN 100
+#define LAYER_THREAD_NAME "ndnrtc-l"
+#define PAR_ABR "Abr"
+#define PAR_ABR_LABEL "Adaptive Bitrate"
+#define PAR_ABR_MIN "Abrminbitrate"
+#define PAR_ABR_MIN_LABEL "ABR Min Bitrate"
+#define PAR_ABR_RECREATE "Abrrecreate"
+#define PAR_ABR_RECREATE_LABEL "ABR Re-create Stream"
+
+// rate controller is evaluated once per interval; on congestion, target is multiplied by
+// ABR_DECREASE, otherwise grows by ABR_INCREASE of the max bitrate per interval
+#define ABR_INTERVAL_MS 1000
+#define ABR_DECREASE 0.85
+#define ABR_INCREASE 0.05
+// share of Interests that were re-requests or late misses, considered a loss
+#define ABR_LOSS_RATIO 0.05
+#define ABR_QUEUE_DELAY_US 50000
+// encoder is re-created only when target bitrate or GOP drifts this much (share of the
+// configured value) from the applied one
+#define ABR_APPLY_THRESHOLD 0.1
 
 using namespace std;
 using namespace std::placeholders;
@@ -126,9 +172,54 @@ extern "C"
 class NdnRtcOut::Impl : public enable_shared_from_this<NdnRtcOut::Impl>
 {
 public:
-    Impl(shared_ptr<spdlog::logger> l)
+    // Publishing counters. Updated on the cook thread (encoding) and on the Face
+    // thread (caching), read by info CHOP without locking.
+    typedef struct _PublishCounters {
+        _PublishCounters(): framesPublished_(0), packetsPublished_(0), bytesPublished_(0),
+            packetsCached_(0), encodeTimeUs_(0), pendingInterests_(0), pendingSatisfied_(0),
+            cacheHits_(0), cacheMisses_(0), cacheEvicted_(0), cacheBytes_(0),
+            repeatRequests_(0), lateMisses_(0), targetBitrate_(0), targetGop_(0) {}
+        
+        atomic<uint64_t> framesPublished_, packetsPublished_, bytesPublished_, packetsCached_;
+        atomic<uint32_t> encodeTimeUs_;
+        atomic<uint64_t> pendingInterests_, pendingSatisfied_;
+        atomic<uint64_t> cacheHits_, cacheMisses_, cacheEvicted_, cacheBytes_;
+        atomic<uint64_t> repeatRequests_, lateMisses_;
+        atomic<uint32_t> targetBitrate_, targetGop_;
+    } PublishCounters;
+    
+    Impl(shared_ptr<spdlog::logger> l, shared_ptr<MemoryCounter> cacheMemory)
     : logger_(l)
     , prefixRegistered_(false)
+    , prefixHandlerId_(0)
+    , cacheLen_(0)
+    , cacheSize_(0)
+    , cacheBytes_(0)
+    , latestKeyNo_(0)
+    , cacheMemory_(cacheMemory)
+    , gopSize_(0)
+    , hasKeyFrame_(false)
+    , streamVersion_(0)
+    , isStreamPending_(false)
+    , pendingBitrate_(0)
+    , pendingGop_(0)
+    , lastFrameNo_(0)
+    , counters_(make_shared<PublishCounters>())
+    , isWorkerRunning_(false)
+    , isJobDone_(true)
+    , jobSrc_(nullptr)
+    , isAbrEnabled_(false)
+    , isAbrRecreateEnabled_(false)
+    , abrMinBitrate_(0)
+    , currentBitrate_(0)
+    , abrTarget_(0)
+    , abrGop_(0)
+    , abrFrames_(0)
+    , abrOverruns_(0)
+    , abrInterests_(0)
+    , abrLosses_(0)
+    , abrDropped_(0)
+    , frameIntervalUs_(0)
     {}
     
     ~Impl(){
@@ -138,53 +229,114 @@ public:
     
     bool getIsInitialized() const { return stream_.get() != nullptr; }
     string getErrorString() const { return errorString_; }
-    string getStreamPrefix() const { return stream_ ? stream_->getPrefix() : "n/a"; }
+    string getStreamPrefix() const
+    {
+        shared_ptr<VideoStream> stream = atomic_load(&stream_);
+        return stream ? stream->getPrefix() : "n/a";
+    }
     uint32_t getFrameNumber() const { return stream_ ? lastFrame_.sampleNo_ : 0; }
     string getLastFramePrefix() const { return stream_ ? lastFrame_.getPrefix(NameFilter::Sample).toUri() : "n/a"; }
-    statistics::StatisticsStorage getStats() const { return stream_->getStatistics(); }
+    const PublishCounters& getCounters() const { return *counters_; }
+    
+    // copies stream statistics into a flat array, reusing its storage
+    void getStats(vector<pair<const char*, double>>& stats) const
+    {
+        stats.clear();
+        shared_ptr<VideoStream> stream = atomic_load(&stream_);
+        if (!stream)
+            return;
+        
+        statistics::StatisticsStorage ss = stream->getStatistics();
+        stats.reserve(ss.getIndicators().size());
+        for (auto &pair:ss.getIndicators())
+            stats.push_back({statistics::StatisticsStorage::IndicatorKeywords.at(pair.first).c_str(),
+                             pair.second});
+    }
     const NamespaceInfo& getLastFrameInfo() const { return lastFrame_; }
     
     void initStream(const string& base, const string &name,
                     const VideoStream::Settings& settings,
-                    const int32_t& cacheLen,
+                    const int32_t& cacheLen, const size_t& cacheSize,
                     shared_ptr<helpers::FaceProcessor> faceProcessor,
                     shared_ptr<KeyChain> keyChain)
     {
         errorString_ = "";
         setFaceProcessor(faceProcessor);
+        keyChain_ = keyChain;
+        base_ = base;
+        name_ = name;
+        settings_ = settings;
+        gopSize_ = settings.codecSettings_.spec_.encoder_.gop_;
+        hasKeyFrame_ = false;
+        streamVersion_ = 0;
+        isStreamPending_ = false;
+        abrTarget_ = currentBitrate_ = settings.codecSettings_.spec_.encoder_.bitrate_;
+        abrGop_ = gopSize_;
+        counters_->targetBitrate_ = (uint32_t)abrTarget_;
+        counters_->targetGop_ = abrGop_;
         
         shared_ptr<Impl> me = shared_from_this();
-        faceProcessor_->dispatchSynchronized([this, me, base, name, settings, cacheLen, keyChain](shared_ptr<Face> f)
+        faceProcessor_->dispatchSynchronized([this, me, base, name, settings, cacheLen, cacheSize, keyChain](shared_ptr<Face> f)
         {
             VideoStream::Settings s(settings);
-            s.memCache_ = make_shared<MemoryContentCache>(f.get());
-            s.memCache_->setMinimumCacheLifetime(cacheLen);
+            cacheLen_ = cacheLen;
+            cacheSize_ = cacheSize;
+            clearCache();
+            atomic_store(&nextStream_, shared_ptr<VideoStream>());
             stream_ = make_shared<VideoStream>(base, name, s, keyChain);
+            streamPrefix_ = joinPrefix_ = Name(stream_->getPrefix());
             logger_->info("Initialized NDN-RTC stream {}", stream_->getPrefix());
             
-            // register prefix for the stream and RVP
+            // register prefix for the stream and RVP; Interests are routed to the packet
+            // cache through Face processor's shared prefix registry
             prefixRegistered_ = false;
             NamespaceInfo ni;
             NameComponents::extractInfo(stream_->getPrefix(), ni);
-            s.memCache_->registerPrefix(ni.getPrefix(NameFilter::Library),
-                                        [me](const shared_ptr<const Name>& n)
-                                        {
-                                            me->errorString_ = "Failed to register prefix "+n->toUri();
-                                            me->logger_->error("Failed to register prefix {}", n->toUri());
-                                        },
-                                        [me](const shared_ptr<const Name>& n, uint64_t)
-                                        {
-                                            me->prefixRegistered_ = true;
-                                            me->logger_->info("Registered prefix {}", n->toUri());
-                                        });
-            
-            settings_ = s;
+            // handler runs on this processor's thread, faceProcessor_ may be reset meanwhile
+            helpers::FaceProcessor *fp = faceProcessor_.get();
+            prefixHandlerId_ =
+            faceProcessor_->registerHandler(ni.getPrefix(NameFilter::Library),
+                                            [me, fp](const shared_ptr<const Name>& prefix,
+                                                 const shared_ptr<const Interest>& interest,
+                                                 Face& face, uint64_t filterId,
+                                                 const shared_ptr<const InterestFilter>& filter)
+                                            {
+                                                me->answerInterest(interest, *fp);
+                                            },
+                                            [me](const shared_ptr<const Name>& n)
+                                            {
+                                                me->errorString_ = "Failed to register prefix "+n->toUri();
+                                                me->logger_->error("Failed to register prefix {}", n->toUri());
+                                            },
+                                            [me](const shared_ptr<const Name>& n, uint64_t)
+                                            {
+                                                me->prefixRegistered_ = true;
+                                                me->logger_->info("Registered prefix {}", n->toUri());
+                                            });
+        });
+    }
+    
+    void setCacheLimits(int32_t cacheLen, size_t cacheSize)
+    {
+        if (!faceProcessor_)
+            return;
+        
+        shared_ptr<Impl> me = shared_from_this();
+        faceProcessor_->dispatchSynchronized([me, cacheLen, cacheSize](shared_ptr<Face>){
+            me->cacheLen_ = cacheLen;
+            me->cacheSize_ = cacheSize;
+            me->expireCached(chrono::steady_clock::now());
         });
     }
     
     void releaseStream(){
+        stopWorker();
+        
         shared_ptr<spdlog::logger> l = logger_;
         shared_ptr<VideoStream> stream = stream_;
+        uint64_t prefixHandlerId = prefixHandlerId_.exchange(0);
+        if (faceProcessor_ && prefixHandlerId)
+            faceProcessor_->unregisterHandler(prefixHandlerId);
         if (faceProcessor_ && stream)
             faceProcessor_->dispatchSynchronized([stream, l](shared_ptr<Face>)
         {
@@ -196,6 +348,11 @@ public:
     }
 
     void publishBgraFrame(const vector<uint8_t>& bgraData, int width, int height){
+        if (convertBgraFrame(bgraData, width, height))
+            publishFrame();
+    }
+    
+    bool convertBgraFrame(const vector<uint8_t>& bgraData, int width, int height){
         allocateYuvData(width, height);
 
         // using ARGB because of endiannes?
@@ -204,16 +361,151 @@ public:
                                      uBuffer(), width/2,
                                      vBuffer(), width/2,
                                      width, height);
-        if (res == 0 && stream_)
+        return res == 0;
+    }
+    
+    // downscales full resolution layer's planes to this layer's size
+    void publishScaledFrame(const Impl& src){
+        int res = libyuv::I420Scale(src.yBuffer(), src.width_,
+                                    src.uBuffer(), src.width_/2,
+                                    src.vBuffer(), src.width_/2,
+                                    src.width_, src.height_,
+                                    yBuffer(), width_,
+                                    uBuffer(), width_/2,
+                                    vBuffer(), width_/2,
+                                    width_, height_, libyuv::kFilterBox);
+        if (res == 0)
+            publishFrame();
+    }
+    
+    void setLayerSize(int width, int height) { allocateYuvData(width, height); }
+    
+    // Simulcast layers scale and encode on their own thread, one frame at a time; source
+    // layer's planes must stay intact until waitWorker() returns.
+    void startWorker(const string& threadName)
+    {
+        isWorkerRunning_ = true;
+        isJobDone_ = true;
+        worker_ = thread([this, threadName](){
+            helpers::ThreadOptions o;
+            o.name_ = threadName;
+            helpers::applyThreadOptions(o);
+            
+            unique_lock<mutex> lock(workerMtx_);
+            while (true)
+            {
+                workerCv_.wait(lock, [this](){ return !isJobDone_ || !isWorkerRunning_; });
+                if (!isWorkerRunning_)
+                    break;
+                
+                lock.unlock();
+                publishScaledFrame(*jobSrc_);
+                lock.lock();
+                
+                isJobDone_ = true;
+                workerCv_.notify_all();
+            }
+        });
+    }
+    
+    void publishScaledFrameAsync(const Impl& src)
+    {
         {
+            lock_guard<mutex> lock(workerMtx_);
+            jobSrc_ = &src;
+            isJobDone_ = false;
+        }
+        workerCv_.notify_all();
+    }
+    
+    void waitWorker()
+    {
+        unique_lock<mutex> lock(workerMtx_);
+        workerCv_.wait(lock, [this](){ return isJobDone_ || !isWorkerRunning_; });
+    }
+    
+    // Adaptive bitrate lowers encoder target (down to minBitrate) and shortens GOP (down to
+    // half of the configured one) when consumers struggle, and brings them back up to the
+    // configured values while they don't. VideoStream can't change encoder settings on the
+    // fly and a new one starts frame numbering over, so targets are applied only if stream
+    // may be re-created under a new name (canRecreate); otherwise they're just reported
+    void setAbr(bool isEnabled, int32_t minBitrate, bool canRecreate)
+    {
+        isAbrEnabled_ = isEnabled;
+        isAbrRecreateEnabled_ = canRecreate;
+        abrMinBitrate_ = min(minBitrate, (int32_t)settings_.codecSettings_.spec_.encoder_.bitrate_);
+        abrTs_ = chrono::steady_clock::now();
+        abrFrames_ = 0;
+        abrOverruns_ = 0;
+        
+        if (!isAbrEnabled_)
+        {
+            // back to configured values at the next GOP boundary
+            abrTarget_ = settings_.codecSettings_.spec_.encoder_.bitrate_;
+            abrGop_ = settings_.codecSettings_.spec_.encoder_.gop_;
+            counters_->targetBitrate_ = (uint32_t)abrTarget_;
+            counters_->targetGop_ = abrGop_;
+        }
+    }
+    
+    void publishFrame(){
+        if (stream_)
+        {
+            // new target is applied by re-creating the stream, which is swapped in where
+            // a keyframe would be anyway
+            if (isAbrRecreateEnabled_ && !isStreamPending_ && isAbrPending())
+                prepareStream();
+            if (isStreamPending_ && isGopEnd())
+                swapStream();
+            
+            auto t = chrono::steady_clock::now();
             vector<shared_ptr<Data>> packets = stream_->processImage(ImageFormat::I420, yuvData_.data());
-            shared_ptr<MemoryContentCache> memCache = settings_.memCache_;
-            faceProcessor_->dispatchSynchronized([packets, memCache](shared_ptr<Face> f){
+            counters_->encodeTimeUs_ = (uint32_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t).count();
+            updateAbr(counters_->encodeTimeUs_);
+            
+            Name nextKeyPrefix;
+            if (packets.size())
+            {
+                size_t nBytes = 0;
+                bool isKey = false;
                 for (auto& d:packets)
-                    memCache->add(*d);
-            });
+                {
+                    nBytes += d->getContent().size();
+                    isKey |= (getPriority(d->getName()) == helpers::DataPriority::Keyframe);
+                }
+                
+                counters_->framesPublished_++;
+                counters_->packetsPublished_ += packets.size();
+                counters_->bytesPublished_ += nBytes;
+                
+                NameComponents::extractInfo(packets[0]->getName(), lastFrame_);
+                if (isKey)
+                {
+                    lastKeyFrame_ = lastFrame_;
+                    hasKeyFrame_ = true;
+                }
+                
+                if (hasKeyFrame_)
+                {
+                    nextKeyPrefix = predictNextKeyFrame();
+                    packets.push_back(makeJoinMeta(nextKeyPrefix));
+                }
+            }
             
-            if (packets.size()) NameComponents::extractInfo(packets[0]->getName(), lastFrame_);
+            shared_ptr<Impl> me = shared_from_this();
+            shared_ptr<PublishCounters> counters = counters_;
+            helpers::FaceProcessor *fp = faceProcessor_.get();
+            uint64_t frameNo = lastFrame_.sampleNo_;
+            faceProcessor_->dispatchSynchronized([packets, frameNo, nextKeyPrefix, me, fp, counters](shared_ptr<Face> f){
+                me->cachePackets(packets);
+                counters->packetsCached_ += packets.size();
+                
+                if (packets.size())
+                    me->lastFrameNo_ = frameNo;
+                if (nextKeyPrefix.size())
+                    me->nextKeyPrefix_ = nextKeyPrefix;
+                me->satisfyPending(packets, *fp);
+            });
         }
     }
     
@@ -221,29 +513,555 @@ private:
     shared_ptr<spdlog::logger> logger_;
     string errorString_;
     shared_ptr<helpers::FaceProcessor> faceProcessor_;
-    helpers::FaceResetConnection faceResetConnection_;
+    // settings of the current stream, stream's base and name; cook thread only
     VideoStream::Settings settings_;
+    string base_, name_;
     shared_ptr<VideoStream> stream_;
+    shared_ptr<KeyChain> keyChain_;
+    
+    // Packets published within the last cacheLen_ ms, up to cacheSize_ bytes. Interests
+    // are answered through FaceProcessor's Data scheduler, with priority by packet type
+    // (MemoryContentCache writes to the Face directly, bypassing it). Face thread only.
+    typedef struct _CachedPacket {
+        shared_ptr<const Data> data_;
+        helpers::DataPriority priority_;
+        chrono::steady_clock::time_point ts_;
+        size_t size_;
+        uint64_t frameNo_;
+        // Interests answered with this packet
+        mutable uint32_t nServed_;
+    } CachedPacket;
+    // Packets are owned by age lists, oldest first -- one for keyframe segments and one for
+    // everything else, so that eviction picks its victim from list fronts without a scan.
+    // Packets of the latest keyframe outlive cacheLen_ and are evicted for size last, as
+    // joining consumers start from it.
+    typedef list<CachedPacket> AgeList;
+    enum AgeListIdx { Other = 0, Key = 1 };
+    array<AgeList, 2> packetsByAge_;
+    typedef map<Name, AgeList::iterator> PacketMap;
+    PacketMap packets_;
+    int32_t cacheLen_;
+    size_t cacheSize_, cacheBytes_;
+    uint64_t latestKeyNo_;
+    TrackedMemory cacheMemory_;
     bool prefixRegistered_;
+    atomic<uint64_t> prefixHandlerId_;
     int width_, height_;
     ndnrtc::NamespaceInfo lastFrame_;
+    // cook thread only
+    int gopSize_;
+    bool hasKeyFrame_;
+    ndnrtc::NamespaceInfo lastKeyFrame_;
+    // times stream was re-created by the rate controller; the next stream is created on
+    // the face thread and stored in nextStream_, cook thread swaps it in
+    int streamVersion_;
+    bool isStreamPending_;
+    int32_t pendingBitrate_;
+    int pendingGop_;
+    shared_ptr<VideoStream> nextStream_;
+    // Interests for frames not published yet -- consumers running ahead of the producer
+    // and joining consumers waiting for the next keyframe. Keyed by Interest name, so that
+    // a new packet finds its Interests by looking up its name and its prefixes. Held until
+    // the packet is published or Interest expires. Face thread only.
+    typedef struct _PendingInterest {
+        shared_ptr<const Interest> interest_;
+        chrono::steady_clock::time_point expiry_;
+    } PendingInterest;
+    typedef multimap<Name, PendingInterest> PendingMap;
+    PendingMap pendingInterests_;
+    chrono::steady_clock::time_point pendingSweepTs_;
+    // prefix of the current stream and of the first one; join metadata stays under the
+    // latter, which is set along with stream_ in initStream() and read like it
+    Name streamPrefix_, joinPrefix_, nextKeyPrefix_;
+    uint64_t lastFrameNo_;
+    shared_ptr<PublishCounters> counters_;
     vector<uint8_t> yuvData_;
+    thread worker_;
+    mutex workerMtx_;
+    condition_variable workerCv_;
+    bool isWorkerRunning_, isJobDone_;
+    const Impl *jobSrc_;
+    // rate controller state, cook thread (or layer's worker) only
+    bool isAbrEnabled_, isAbrRecreateEnabled_;
+    int32_t abrMinBitrate_, currentBitrate_;
+    double abrTarget_;
+    int abrGop_;
+    uint32_t abrFrames_, abrOverruns_;
+    uint64_t abrInterests_, abrLosses_, abrDropped_;
+    uint32_t frameIntervalUs_;
+    chrono::steady_clock::time_point abrTs_, lastFrameTs_;
     
-    void setFaceProcessor(shared_ptr<helpers::FaceProcessor> fp)
+    void updateAbr(uint32_t encodeTimeUs)
     {
-        if (faceProcessor_) faceResetConnection_.disconnect();
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (lastFrameTs_ != chrono::steady_clock::time_point())
+        {
+            uint32_t intervalUs = (uint32_t)chrono::duration_cast<chrono::microseconds>(now - lastFrameTs_).count();
+            frameIntervalUs_ = (frameIntervalUs_ ? (7*frameIntervalUs_ + intervalUs) / 8 : intervalUs);
+        }
+        lastFrameTs_ = now;
         
-        faceProcessor_ = fp;
+        if (!isAbrEnabled_)
+            return;
+        
+        // encoder doesn't keep up with the input
+        abrFrames_++;
+        if (frameIntervalUs_ && encodeTimeUs > frameIntervalUs_)
+            abrOverruns_++;
+        
+        if (now - abrTs_ < chrono::milliseconds(ABR_INTERVAL_MS))
+            return;
+        abrTs_ = now;
+        
+        uint64_t nInterests = counters_->cacheHits_ + counters_->cacheMisses_;
+        uint64_t nLosses = counters_->repeatRequests_ + counters_->lateMisses_;
+        uint64_t nDropped = (faceProcessor_ ? faceProcessor_->getDataDroppedNum() : 0);
+        uint64_t dInterests = nInterests - abrInterests_, dLosses = nLosses - abrLosses_;
+        bool isDropping = (nDropped > abrDropped_);
+        abrInterests_ = nInterests;
+        abrLosses_ = nLosses;
+        abrDropped_ = nDropped;
+        
+        bool isLossy = dInterests && (double)dLosses / (double)dInterests > ABR_LOSS_RATIO;
+        bool isCongested = isLossy || isDropping ||
+            (faceProcessor_ && faceProcessor_->getDataDelayUs() > ABR_QUEUE_DELAY_US) ||
+            abrOverruns_ > abrFrames_ / 4;
+        abrFrames_ = 0;
+        abrOverruns_ = 0;
+        
+        int32_t maxBitrate = settings_.codecSettings_.spec_.encoder_.bitrate_;
+        int maxGop = settings_.codecSettings_.spec_.encoder_.gop_;
+        if (isCongested)
+            abrTarget_ = max((double)abrMinBitrate_, abrTarget_ * ABR_DECREASE);
+        else if (dInterests)
+            // nobody's fetching -- nothing to probe with
+            abrTarget_ = min((double)maxBitrate, abrTarget_ + maxBitrate * ABR_INCREASE);
+        
+        // losses hurt less with keyframes coming more often
+        if (isLossy)
+            abrGop_ = max(max(maxGop / 2, 1), abrGop_ * 3 / 4);
+        else
+            abrGop_ = min(maxGop, abrGop_ + max(maxGop / 10, 1));
+        
+        counters_->targetBitrate_ = (uint32_t)abrTarget_;
+        counters_->targetGop_ = abrGop_;
+    }
+    
+    bool isAbrPending() const
+    {
+        int32_t bitrate = settings_.codecSettings_.spec_.encoder_.bitrate_;
+        int gop = settings_.codecSettings_.spec_.encoder_.gop_;
+        return (abs(abrGop_ - gopSize_) > ABR_APPLY_THRESHOLD * gop ||
+                fabs(abrTarget_ - (double)currentBitrate_) > ABR_APPLY_THRESHOLD * bitrate);
+    }
+    
+    // next frame is expected to be a keyframe
+    bool isGopEnd() const
+    {
+        return hasKeyFrame_ && lastFrame_.sampleNo_ + 1 >= lastKeyFrame_.sampleNo_ + gopSize_;
+    }
+    
+    // encoder set up takes a while, so it's done on the face thread (where streams are
+    // created and released, like in initStream()) rather than on the cook thread
+    void prepareStream()
+    {
+        if (!faceProcessor_)
+            return;
+        
+        VideoStream::Settings s(settings_);
+        s.codecSettings_.spec_.encoder_.bitrate_ = pendingBitrate_ = (int32_t)abrTarget_;
+        s.codecSettings_.spec_.encoder_.gop_ = pendingGop_ = abrGop_;
+        isStreamPending_ = true;
+        
+        // new stream starts frame numbering over, so it gets a new name -- re-using the
+        // old one would republish names consumers and caches already have; consumers learn
+        // the current stream from join metadata
+        string base = base_, name = name_ + STREAM_VERSION_SEPARATOR + to_string(++streamVersion_);
+        shared_ptr<KeyChain> keyChain = keyChain_;
         shared_ptr<Impl> me = shared_from_this();
-        faceResetConnection_ = faceProcessor_->onFaceReset_.connect([me, fp](const shared_ptr<Face>, const exception&){
-            me->stream_.reset();
-            me->faceResetConnection_.disconnect();
+        faceProcessor_->dispatchSynchronized([me, s, base, name, keyChain](shared_ptr<Face>){
+            atomic_store(&me->nextStream_, make_shared<VideoStream>(base, name, s, keyChain));
         });
     }
     
+    // swaps in the prepared stream, if it's ready; otherwise it's tried at the next GOP end
+    void swapStream()
+    {
+        shared_ptr<VideoStream> oldStream = stream_;
+        shared_ptr<VideoStream> stream = atomic_exchange(&nextStream_, shared_ptr<VideoStream>());
+        if (!stream)
+            return;
+        
+        atomic_store(&stream_, stream);
+        isStreamPending_ = false;
+        currentBitrate_ = pendingBitrate_;
+        gopSize_ = pendingGop_;
+        hasKeyFrame_ = false;
+        
+        // dispatched ahead of the new stream's packets
+        shared_ptr<Impl> me = shared_from_this();
+        Name prefix(stream->getPrefix());
+        int32_t bitrate = pendingBitrate_;
+        int gop = pendingGop_;
+        faceProcessor_->dispatchSynchronized([me, oldStream, prefix, bitrate, gop](shared_ptr<Face>){
+            me->streamPrefix_ = prefix;
+            // old stream's frames are served from the cache until they expire, but joining
+            // consumers wait for the new stream's keyframe
+            me->latestKeyNo_ = 0;
+            me->nextKeyPrefix_.clear();
+            me->lastFrameNo_ = 0;
+            me->logger_->info("Re-created NDN-RTC stream {}: bitrate {} GOP {}",
+                              prefix.toUri(), bitrate, gop);
+            // old stream is released here, on the face thread
+        });
+    }
+    
+    void stopWorker()
+    {
+        if (!worker_.joinable())
+            return;
+        
+        {
+            lock_guard<mutex> lock(workerMtx_);
+            isWorkerRunning_ = false;
+        }
+        workerCv_.notify_all();
+        worker_.join();
+    }
+    
+    void setFaceProcessor(shared_ptr<helpers::FaceProcessor> fp)
+    {
+        // stream and packet cache don't depend on Face and prefix handler is restored by
+        // FaceProcessor, so there's nothing to do on Face recovery
+        faceProcessor_ = fp;
+    }
+    
+    void clearCache()
+    {
+        packets_.clear();
+        for (auto& l:packetsByAge_)
+            l.clear();
+        cacheBytes_ = 0;
+        latestKeyNo_ = 0;
+        cacheMemory_.set(0);
+        counters_->cacheBytes_ = 0;
+        pendingInterests_.clear();
+        nextKeyPrefix_.clear();
+        lastFrameNo_ = 0;
+        counters_->pendingInterests_ = 0;
+    }
+    
+    // best effort: assumes encoder keeps fixed GOP, so next keyframe is expected gopSize_
+    // frames after the last one
+    Name predictNextKeyFrame() const
+    {
+        NamespaceInfo next(lastKeyFrame_);
+        next.sampleNo_ += max(gopSize_, 1);
+        while (next.sampleNo_ <= lastFrame_.sampleNo_)
+            next.sampleNo_ += max(gopSize_, 1);
+        return next.getPrefix(NameFilter::Sample);
+    }
+    
+    // Join metadata lets consumers start at the latest keyframe or wait for the next one,
+    // instead of probing the stream. Published every frame under a new version with short
+    // freshness, so MustBeFresh prefix Interest gets the latest one from the cache. Stays
+    // under the first stream's prefix and points to the current stream, which changes when
+    // the rate controller re-creates it.
+    shared_ptr<Data> makeJoinMeta(const Name& nextKeyPrefix) const
+    {
+        uint64_t ts = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        json11::Json meta = json11::Json::object {
+            { "keyframe", lastKeyFrame_.getPrefix(NameFilter::Sample).toUri() },
+            { "keyframeNo", (double)lastKeyFrame_.sampleNo_ },
+            { "frameNo", (double)lastFrame_.sampleNo_ },
+            { "gopPos", (double)(lastFrame_.sampleNo_ - lastKeyFrame_.sampleNo_) },
+            { "gopSize", gopSize_ },
+            { "nextKeyframe", nextKeyPrefix.toUri() },
+            { "stream", stream_->getPrefix() },
+            { "timestamp", (double)ts }
+        };
+        
+        Name n(joinPrefix_);
+        n.append(JOIN_META_COMPONENT).appendVersion(ts);
+        
+        shared_ptr<Data> d = make_shared<Data>(n);
+        d->getMetaInfo().setFreshnessPeriod(JOIN_META_FRESHNESS_MS);
+        d->setContent(Blob::fromRawStr(meta.dump()));
+        // refreshed every frame -- digest signature keeps it cheap
+        keyChain_->signWithSha256(*d);
+        
+        return d;
+    }
+    
+    static helpers::DataPriority getPriority(const Name& n)
+    {
+        NamespaceInfo ni;
+        return getPriority(n, ni);
+    }
+    
+    static helpers::DataPriority getPriority(const Name& n, NamespaceInfo& ni)
+    {
+        if (NameComponents::extractInfo(n, ni) &&
+            (ni.segmentClass_ == SegmentClass::Data || ni.segmentClass_ == SegmentClass::Parity))
+            return (ni.class_ == SampleClass::Key ? helpers::DataPriority::Keyframe :
+                    helpers::DataPriority::Delta);
+        // frame manifests and meta, stream meta and pointers
+        return helpers::DataPriority::Metadata;
+    }
+    
+    static AgeListIdx getAgeList(helpers::DataPriority priority)
+    {
+        return (priority == helpers::DataPriority::Keyframe ? Key : Other);
+    }
+    
+    void cachePackets(const vector<shared_ptr<Data>>& packets)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for (auto& d:packets)
+        {
+            NamespaceInfo ni;
+            helpers::DataPriority priority = getPriority(d->getName(), ni);
+            CachedPacket p = { d, priority, now, d->getDefaultWireEncoding().size(),
+                (priority == helpers::DataPriority::Metadata ? 0 : (uint64_t)ni.sampleNo_), 0 };
+            AgeList &l = packetsByAge_[getAgeList(priority)];
+            
+            auto it = packets_.find(d->getName());
+            if (it != packets_.end())
+            {
+                // re-published packet moves to the back of its age list
+                removeBytes(it->second->size_);
+                l.splice(l.end(), packetsByAge_[getAgeList(it->second->priority_)], it->second);
+                *it->second = p;
+            }
+            else
+                packets_[d->getName()] = l.insert(l.end(), p);
+            
+            addBytes(p.size_);
+            if (priority == helpers::DataPriority::Keyframe)
+                latestKeyNo_ = max(latestKeyNo_, p.frameNo_);
+        }
+        
+        expireCached(now);
+    }
+    
+    bool isLatestKey(const CachedPacket& p) const
+    {
+        return p.priority_ == helpers::DataPriority::Keyframe && p.frameNo_ == latestKeyNo_ &&
+            streamPrefix_.isPrefixOf(p.data_->getName());
+    }
+    
+    void expireCached(const chrono::steady_clock::time_point& now)
+    {
+        for (auto& l:packetsByAge_)
+            while (l.size() && now - l.front().ts_ > chrono::milliseconds(cacheLen_) &&
+                   !isLatestKey(l.front()))
+                evictFront(l);
+        
+        while (cacheSize_ && cacheBytes_ > cacheSize_)
+        {
+            evictFront(selectVictim());
+            counters_->cacheEvicted_++;
+        }
+    }
+    
+    // oldest packet, unless it belongs to the latest keyframe
+    AgeList& selectVictim()
+    {
+        AgeList &other = packetsByAge_[Other], &keys = packetsByAge_[Key];
+        
+        if (keys.empty() || (other.size() && isLatestKey(keys.front())))
+            return other;
+        if (other.empty() || keys.front().ts_ < other.front().ts_)
+            return keys;
+        return other;
+    }
+    
+    void evictFront(AgeList& l)
+    {
+        removeBytes(l.front().size_);
+        packets_.erase(l.front().data_->getName());
+        l.pop_front();
+    }
+    
+    void addBytes(size_t n)
+    {
+        cacheBytes_ += n;
+        cacheMemory_.add(n);
+        counters_->cacheBytes_ = cacheBytes_;
+    }
+    
+    void removeBytes(size_t n)
+    {
+        cacheBytes_ -= n;
+        cacheMemory_.add(-(int64_t)n);
+        counters_->cacheBytes_ = cacheBytes_;
+    }
+    
+    // prefix Interests get the latest (rightmost) matching packet, which is what live
+    // stream consumers are after
+    const CachedPacket* findPacket(const Interest& i, const chrono::steady_clock::time_point& now) const
+    {
+        const CachedPacket *res = nullptr;
+        auto isFresh = [&now](const CachedPacket& p){
+            double freshnessMs = p.data_->getMetaInfo().getFreshnessPeriod();
+            return freshnessMs > 0 && now - p.ts_ < chrono::milliseconds((int64_t)freshnessMs);
+        };
+        
+        if (!i.getCanBePrefix())
+        {
+            auto it = packets_.find(i.getName());
+            if (it != packets_.end() && (!i.getMustBeFresh() || isFresh(*it->second)))
+                res = &*it->second;
+        }
+        else
+        {
+            // names under the prefix sort before prefix's successor, so scanning backwards
+            // from there, first match is the one we're after
+            auto first = packets_.lower_bound(i.getName());
+            for (auto it = packets_.lower_bound(i.getName().getSuccessor()); it != first; )
+            {
+                --it;
+                if (i.matchesData(*it->second->data_) && (!i.getMustBeFresh() || isFresh(*it->second)))
+                {
+                    res = &*it->second;
+                    break;
+                }
+            }
+        }
+        
+        return res;
+    }
+    
+    // called on the Face thread
+    void answerInterest(const shared_ptr<const Interest>& i, helpers::FaceProcessor& fp)
+    {
+        // handler is registered for the library prefix, which is shared with other
+        // streams on this host (including simulcast layers) -- their Interests aren't
+        // ours to count
+        if (!isOwnName(i->getName()))
+            return;
+        
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        expireCached(now);
+        
+        const CachedPacket *p = findPacket(*i, now);
+        if (p)
+        {
+            counters_->cacheHits_++;
+            // downstream caches and PIT aggregation absorb most of the repeated Interests,
+            // the ones that get here are mostly retransmissions
+            if (p->nServed_++)
+                counters_->repeatRequests_++;
+            fp.putData(p->data_, p->priority_);
+        }
+        else
+        {
+            counters_->cacheMisses_++;
+            if (isFutureFrame(i->getName()))
+                holdInterest(i, now);
+            else
+                // consumer is behind cache length
+                counters_->lateMisses_++;
+        }
+    }
+    
+    bool isOwnName(const Name& n) const
+    {
+        if (!streamPrefix_.size())
+            return false;
+        if (streamPrefix_.isPrefixOf(n) || joinPrefix_.isPrefixOf(n))
+            return true;
+        
+        // streams replaced by the rate controller, while their packets are cached
+        NamespaceInfo ni;
+        if (!NameComponents::extractInfo(n, ni))
+            return false;
+        Name prefix = ni.getPrefix(NameFilter::Stream);
+        auto it = packets_.lower_bound(prefix);
+        return it != packets_.end() && prefix.isPrefixOf(it->first);
+    }
+    
+    bool isFutureFrame(const Name& n) const
+    {
+        // joining consumer waits for the start of the next GOP
+        if (nextKeyPrefix_.size() && nextKeyPrefix_.isPrefixOf(n))
+            return true;
+        
+        NamespaceInfo ni;
+        return streamPrefix_.size() && streamPrefix_.isPrefixOf(n) &&
+            NameComponents::extractInfo(n, ni) &&
+            ni.sampleNo_ > lastFrameNo_ && ni.sampleNo_ <= lastFrameNo_ + PENDING_FRAMES_AHEAD;
+    }
+    
+    void holdInterest(const shared_ptr<const Interest>& i, const chrono::steady_clock::time_point& now)
+    {
+        double lifetimeMs = i->getInterestLifetimeMilliseconds();
+        if (lifetimeMs < 0)
+            lifetimeMs = DEFAULT_INTEREST_LIFETIME_MS;
+        PendingInterest pi = { i, now + chrono::milliseconds((int64_t)lifetimeMs) };
+        
+        // retransmission of the held Interest just extends it
+        auto range = pendingInterests_.equal_range(i->getName());
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second.interest_->getCanBePrefix() == i->getCanBePrefix() &&
+                it->second.interest_->getMustBeFresh() == i->getMustBeFresh())
+            {
+                it->second = pi;
+                return;
+            }
+        
+        if (pendingInterests_.size() >= PENDING_INTERESTS_MAX)
+            expirePending(now);
+        if (pendingInterests_.size() < PENDING_INTERESTS_MAX)
+            pendingInterests_.insert(range.second, make_pair(i->getName(), pi));
+        counters_->pendingInterests_ = pendingInterests_.size();
+    }
+    
+    // called on the Face thread after new packets were cached
+    void satisfyPending(const vector<shared_ptr<Data>>& packets, helpers::FaceProcessor& fp)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        
+        for (auto& d:packets)
+        {
+            if (pendingInterests_.empty())
+                break;
+            
+            const Name& n = d->getName();
+            for (size_t len = n.size(); len > streamPrefix_.size(); --len)
+            {
+                auto range = pendingInterests_.equal_range(n.getPrefix(len));
+                for (auto it = range.first; it != range.second; )
+                {
+                    if (it->second.expiry_ > now && it->second.interest_->matchesData(*d))
+                    {
+                        fp.putData(d, getPriority(n));
+                        counters_->pendingSatisfied_++;
+                        it = pendingInterests_.erase(it);
+                    }
+                    else
+                        ++it;
+                }
+            }
+        }
+        
+        if (now - pendingSweepTs_ > chrono::milliseconds(PENDING_SWEEP_MS))
+            expirePending(now);
+        counters_->pendingInterests_ = pendingInterests_.size();
+    }
+    
+    void expirePending(const chrono::steady_clock::time_point& now)
+    {
+        for (auto it = pendingInterests_.begin(); it != pendingInterests_.end(); )
+            if (it->second.expiry_ <= now)
+                it = pendingInterests_.erase(it);
+            else
+                ++it;
+        pendingSweepTs_ = now;
+    }
+    
     void cleanupFaceProcessor()
     {
-        if (faceProcessor_) faceResetConnection_.disconnect();
         faceProcessor_.reset();
     }
     
@@ -260,8 +1078,23 @@ private:
     inline uint8_t* yBuffer() { return (uint8_t*)yuvData_.data(); }
     inline uint8_t* uBuffer() { return yBuffer() + width_*height_; }
     inline uint8_t* vBuffer() { return uBuffer() + width_/2 * ((height_+1) >> 1); }
+    inline const uint8_t* yBuffer() const { return yuvData_.data(); }
+    inline const uint8_t* uBuffer() const { return yBuffer() + width_*height_; }
+    inline const uint8_t* vBuffer() const { return uBuffer() + width_/2 * ((height_+1) >> 1); }
 };
 
+static VideoStream::Settings makeStreamSettings(int32_t bitrate, int32_t gopSize, bool dropFrames, bool useFec)
+{
+    VideoStream::Settings streamSettings = VideoStream::defaultSettings();
+    streamSettings.codecSettings_.spec_.encoder_.bitrate_ = bitrate;
+    streamSettings.codecSettings_.spec_.encoder_.gop_ = gopSize;
+    streamSettings.codecSettings_.spec_.encoder_.dropFrames_ = dropFrames;
+    streamSettings.useFec_ = useFec;
+    // we'll stuff packets into memcache ourselves
+    streamSettings.storeInMemCache_ = false;
+    return streamSettings;
+}
+
 NdnRtcOut::NdnRtcOut(const OP_NodeInfo* info)
 : BaseTOP(info)
 , useFec_(true)
@@ -270,6 +1103,14 @@ NdnRtcOut::NdnRtcOut(const OP_NodeInfo* info)
 , segmentSize_(7600)
 , gopSize_(30)
 , isCacheEnabled_(true)
+, cacheLength_(1000)
+, cacheSize_(64)
+, nLayers_(1)
+, isAbrEnabled_(false)
+, isAbrRecreateEnabled_(false)
+, abrMinBitrate_(300)
+, layersWidth_(0)
+, layersHeight_(0)
 , bufferWidth_(0)
 , bufferHeight_(0)
 {
@@ -331,7 +1172,10 @@ NdnRtcOut::execute(TOP_OutputFormatSpecs* outputFormat,
                 if (frameData)
                     memcpy(buffer_.data(), frameData, buffer_.size());
 
-                pimpl_->publishBgraFrame(buffer_, input->width, input->height);
+                if (nLayers_ > 1)
+                    publishLayers(input->width, input->height);
+                else
+                    pimpl_->publishBgraFrame(buffer_, input->width, input->height);
             }
         }
     }
@@ -380,6 +1224,60 @@ NdnRtcOut::setupParameters(OP_ParameterManager *manager, void *reserved1)
         return manager->appendInt(p);
     });
     
+    appendPar<OP_NumericParameter>
+    (manager, PAR_CACHE_LENGTH, PAR_CACHE_LENGTH_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
+        p.defaultValues[0] = cacheLength_;
+        p.minValues[0] = 100;
+        p.minSliders[0] = p.minValues[0];
+        p.maxValues[0] = 60000;
+        p.maxSliders[0] = 10000;
+        return manager->appendInt(p);
+    });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_CACHE_SIZE, PAR_CACHE_SIZE_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
+        p.defaultValues[0] = cacheSize_;
+        p.minValues[0] = 1;
+        p.minSliders[0] = p.minValues[0];
+        p.maxValues[0] = 4096;
+        p.maxSliders[0] = 512;
+        return manager->appendInt(p);
+    });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_LAYERS, PAR_LAYERS_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
+        p.defaultValues[0] = nLayers_;
+        p.minValues[0] = 1;
+        p.minSliders[0] = p.minValues[0];
+        p.maxValues[0] = LAYERS_MAX;
+        p.maxSliders[0] = p.maxValues[0];
+        p.clampMins[0] = true;
+        p.clampMaxes[0] = true;
+        return manager->appendInt(p);
+    });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_ABR, PAR_ABR_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
+        p.defaultValues[0] = isAbrEnabled_;
+        return manager->appendToggle(p);
+    });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_ABR_MIN, PAR_ABR_MIN_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
+        p.defaultValues[0] = abrMinBitrate_;
+        p.minValues[0] = LAYER_BITRATE_MIN;
+        p.minSliders[0] = p.minValues[0];
+        p.maxValues[0] = targetBitrate_*10;
+        p.maxSliders[0] = targetBitrate_;
+        return manager->appendInt(p);
+    });
+    
+    appendPar<OP_NumericParameter>
+    (manager, PAR_ABR_RECREATE, PAR_ABR_RECREATE_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
+        p.defaultValues[0] = isAbrRecreateEnabled_;
+        return manager->appendToggle(p);
+    });
+    
     appendPar<OP_NumericParameter>
     (manager, PAR_USEFEC, PAR_USEFEC_LABEL, PAR_PAGE_DEFAULT, [&](OP_NumericParameter &p){
         p.defaultValues[0] = useFec_;
@@ -419,6 +1317,18 @@ NdnRtcOut::checkParams(TOP_OutputFormatSpecs *outputFormat, const OP_Inputs *inp
     (PAR_SEGSIZE, segmentSize_, inputs->getParInt(PAR_SEGSIZE));
     updateIfNew<int>
     (PAR_GOP_SIZE, gopSize_, inputs->getParInt(PAR_GOP_SIZE));
+    updateIfNew<int>
+    (PAR_CACHE_LENGTH, cacheLength_, inputs->getParInt(PAR_CACHE_LENGTH));
+    updateIfNew<int>
+    (PAR_CACHE_SIZE, cacheSize_, inputs->getParInt(PAR_CACHE_SIZE));
+    updateIfNew<int>
+    (PAR_LAYERS, nLayers_, inputs->getParInt(PAR_LAYERS));
+    updateIfNew<bool>
+    (PAR_ABR, isAbrEnabled_, inputs->getParInt(PAR_ABR));
+    updateIfNew<int>
+    (PAR_ABR_MIN, abrMinBitrate_, inputs->getParInt(PAR_ABR_MIN));
+    updateIfNew<bool>
+    (PAR_ABR_RECREATE, isAbrRecreateEnabled_, inputs->getParInt(PAR_ABR_RECREATE));
 }
 
 void
@@ -440,9 +1350,20 @@ NdnRtcOut::paramsUpdated()
         });
     });
     
-    runIfUpdatedAny({PAR_USEFEC, PAR_BITRATE, PAR_SEGSIZE, PAR_DROPFRAMES}, [this](){
+    runIfUpdatedAny({PAR_USEFEC, PAR_BITRATE, PAR_SEGSIZE, PAR_DROPFRAMES, PAR_LAYERS}, [this](){
         releaseStream();
     });
+    
+    runIfUpdatedAny({PAR_CACHE_LENGTH, PAR_CACHE_SIZE}, [this](){
+        if (pimpl_)
+            pimpl_->setCacheLimits((isCacheEnabled_ ? cacheLength_ : 1000), getCacheSizeBytes());
+        for (auto& l:subLayers_)
+            l->setCacheLimits((isCacheEnabled_ ? cacheLength_ : 1000), getCacheSizeBytes());
+    });
+    
+    runIfUpdatedAny({PAR_ABR, PAR_ABR_MIN, PAR_ABR_RECREATE}, [this](){
+        applyAbr();
+    });
 }
 
 void
@@ -452,30 +1373,124 @@ NdnRtcOut::initStream()
     {
         if (getFaceDatOp()->getFaceProcessor() && getKeyChainDatOp()->getKeyChainManager())
         {
-            VideoStream::Settings streamSettings = VideoStream::defaultSettings();
-            streamSettings.codecSettings_.spec_.encoder_.bitrate_ = targetBitrate_;
-            streamSettings.codecSettings_.spec_.encoder_.gop_ = gopSize_;
-            streamSettings.codecSettings_.spec_.encoder_.dropFrames_ = dropFrames_;
-            streamSettings.useFec_ = useFec_;
-            // we'll stuff packets into memcache ourselves
-            streamSettings.storeInMemCache_ = false;
+            VideoStream::Settings streamSettings = makeStreamSettings(targetBitrate_, gopSize_,
+                                                                      dropFrames_, useFec_);
             
             clearError();
-            pimpl_ = make_shared<Impl>(logger_);
-            pimpl_->initStream(BasePrefix, opName_, streamSettings,
-                               (isCacheEnabled_ ? cacheLength_ : 1000),
+            pimpl_ = make_shared<Impl>(logger_, trackMemory("cache"));
+            // in simulcast mode, full resolution is layer 0 and all layers share stream's prefix
+            pimpl_->initStream((nLayers_ > 1 ? getLayersBase() : BasePrefix),
+                               (nLayers_ > 1 ? getLayerName(0) : opName_),
+                               streamSettings,
+                               (isCacheEnabled_ ? cacheLength_ : 1000), getCacheSizeBytes(),
                                getFaceDatOp()->getFaceProcessor(),
                                getKeyChainDatOp()->getKeyChainManager()->instanceKeyChain());
+            applyAbr();
         }
     }
     else
         setError("Face DAT of KeyChain DAT is not specified");
 }
 
+void
+NdnRtcOut::initLayers(int width, int height)
+{
+    releaseLayers();
+    layersWidth_ = width;
+    layersHeight_ = height;
+    
+    if (!(getFaceDatOp() && getFaceDatOp()->getFaceProcessor() &&
+          getKeyChainDatOp() && getKeyChainDatOp()->getKeyChainManager()))
+        return;
+    
+    // each layer halves resolution of the previous one, bitrate follows pixel count; GOP
+    // is the same, so consumers can switch layers at keyframes
+    for (int i = 1; i < nLayers_; ++i)
+    {
+        int w = (width >> i) & ~1, h = (height >> i) & ~1;
+        if (w < 2 || h < 2)
+            break;
+        
+        VideoStream::Settings streamSettings =
+            makeStreamSettings(max(LAYER_BITRATE_MIN, targetBitrate_ >> (2*i)), gopSize_,
+                               dropFrames_, useFec_);
+        streamSettings.codecSettings_.spec_.encoder_.width_ = w;
+        streamSettings.codecSettings_.spec_.encoder_.height_ = h;
+        
+        shared_ptr<Impl> layer = make_shared<Impl>(logger_, trackMemory("cache"));
+        layer->setLayerSize(w, h);
+        layer->initStream(getLayersBase(), getLayerName(i), streamSettings,
+                          (isCacheEnabled_ ? cacheLength_ : 1000), getCacheSizeBytes(),
+                          getFaceDatOp()->getFaceProcessor(),
+                          getKeyChainDatOp()->getKeyChainManager()->instanceKeyChain());
+        layer->setAbr(isAbrEnabled_, getLayerAbrMinBitrate(i), isAbrRecreateEnabled_);
+        layer->startWorker(LAYER_THREAD_NAME+to_string(i));
+        subLayers_.push_back(layer);
+    }
+}
+
+void
+NdnRtcOut::applyAbr()
+{
+    // each layer adapts on its own signals
+    if (pimpl_)
+        pimpl_->setAbr(isAbrEnabled_, getLayerAbrMinBitrate(0), isAbrRecreateEnabled_);
+    for (size_t i = 0; i < subLayers_.size(); ++i)
+        subLayers_[i]->setAbr(isAbrEnabled_, getLayerAbrMinBitrate((int)i+1), isAbrRecreateEnabled_);
+}
+
+int32_t
+NdnRtcOut::getLayerAbrMinBitrate(int layerIdx) const
+{
+    return max(LAYER_BITRATE_MIN, abrMinBitrate_ >> (2*layerIdx));
+}
+
+void
+NdnRtcOut::publishLayers(int width, int height)
+{
+    if (width != layersWidth_ || height != layersHeight_)
+        initLayers(width, height);
+    
+    // frame is converted once; downscaled layers are encoded on their threads while
+    // full resolution one is encoded here
+    if (!pimpl_->convertBgraFrame(buffer_, width, height))
+        return;
+    
+    for (auto& l:subLayers_)
+        l->publishScaledFrameAsync(*pimpl_);
+    pimpl_->publishFrame();
+    for (auto& l:subLayers_)
+        l->waitWorker();
+}
+
+void
+NdnRtcOut::releaseLayers()
+{
+    for (auto& l:subLayers_)
+        l->releaseStream();
+    subLayers_.clear();
+    layersWidth_ = 0;
+    layersHeight_ = 0;
+}
+
+string
+NdnRtcOut::getLayersBase() const
+{
+    return BasePrefix + "/" + opName_;
+}
+
+string
+NdnRtcOut::getLayerName(int layerIdx) const
+{
+    return "l" + to_string(layerIdx);
+}
+
 void
 NdnRtcOut::releaseStream()
 {
-    pimpl_->releaseStream();
+    releaseLayers();
+    if (pimpl_)
+        pimpl_->releaseStream();
     pimpl_.reset();
 }
 
@@ -496,7 +1511,20 @@ NdnRtcOut::opPathUpdated(const std::string &oldFullPath,
 //******************************************************************************
 // InfoDAT and InfoCHOP
 const map<NdnRtcOut::InfoChopIndex, string> NdnRtcOut::ChanNames = {
-    { NdnRtcOut::InfoChopIndex::FrameNumber, "frameNumber" }
+    { NdnRtcOut::InfoChopIndex::FrameNumber, "frameNumber" },
+    { NdnRtcOut::InfoChopIndex::FramesPublished, "framesPublished" },
+    { NdnRtcOut::InfoChopIndex::PacketsPublished, "packetsPublished" },
+    { NdnRtcOut::InfoChopIndex::BytesPublished, "bytesPublished" },
+    { NdnRtcOut::InfoChopIndex::PacketsCached, "packetsCached" },
+    { NdnRtcOut::InfoChopIndex::EncodeTimeUs, "encodeTimeUs" },
+    { NdnRtcOut::InfoChopIndex::PendingInterests, "pendingInterests" },
+    { NdnRtcOut::InfoChopIndex::PendingSatisfied, "pendingSatisfied" },
+    { NdnRtcOut::InfoChopIndex::CacheHitRate, "cacheHitRate" },
+    { NdnRtcOut::InfoChopIndex::CacheEvictionRate, "cacheEvictionRate" },
+    { NdnRtcOut::InfoChopIndex::CacheBytes, "cacheBytes" },
+    { NdnRtcOut::InfoChopIndex::LayersNum, "layersNum" },
+    { NdnRtcOut::InfoChopIndex::TargetBitrate, "targetBitrate" },
+    { NdnRtcOut::InfoChopIndex::TargetGop, "targetGop" }
 };
 
 const map<NdnRtcOut::InfoDatIndex, string> NdnRtcOut::RowNames = {
@@ -508,22 +1536,19 @@ const map<NdnRtcOut::InfoDatIndex, string> NdnRtcOut::RowNames = {
 int32_t
 NdnRtcOut::getNumInfoCHOPChans(void* reserved1)
 {
-    int nStats = 0;
+    // TD asks for channel count first, then for each channel -- take statistics
+    // snapshot here, once per cook
     if (pimpl_ && pimpl_->getIsInitialized())
-        nStats += pimpl_->getStats().getIndicators().size();
-    return BaseTOP::getNumInfoCHOPChans(reserved1) + (int32_t) ChanNames.size() + nStats;
+        pimpl_->getStats(statsSnapshot_);
+    else
+        statsSnapshot_.clear();
+    
+    return BaseTOP::getNumInfoCHOPChans(reserved1) + (int32_t) ChanNames.size() + (int32_t)statsSnapshot_.size();
 }
 
 void
 NdnRtcOut::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
 {
-    int nStats = 0;
-    if (pimpl_ && pimpl_->getIsInitialized())
-    {
-        statistics::StatisticsStorage ss = pimpl_->getStats();
-        nStats += ss.getIndicators().size();
-    }
-    
     NdnRtcOut::InfoChopIndex idx = (NdnRtcOut::InfoChopIndex)index;
     
     if (index < ChanNames.size())
@@ -536,6 +1561,54 @@ NdnRtcOut::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1
                 chan->value = pimpl_ ? pimpl_->getFrameNumber() : -1;
             }
                 break;
+            case NdnRtcOut::InfoChopIndex::FramesPublished:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().framesPublished_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::PacketsPublished:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().packetsPublished_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::BytesPublished:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().bytesPublished_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::PacketsCached:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().packetsCached_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::EncodeTimeUs:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().encodeTimeUs_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::PendingInterests:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().pendingInterests_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::PendingSatisfied:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().pendingSatisfied_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::CacheHitRate:
+            {
+                // share of Interests answered from the cache
+                uint64_t nHits = pimpl_ ? pimpl_->getCounters().cacheHits_.load() : 0;
+                uint64_t nInterests = nHits + (pimpl_ ? pimpl_->getCounters().cacheMisses_.load() : 0);
+                chan->value = nInterests ? (float)nHits / (float)nInterests : 0;
+            }
+                break;
+            case NdnRtcOut::InfoChopIndex::CacheEvictionRate:
+            {
+                // share of cached packets dropped for size before they expired
+                uint64_t nCached = pimpl_ ? pimpl_->getCounters().packetsCached_.load() : 0;
+                chan->value = nCached ? (float)pimpl_->getCounters().cacheEvicted_ / (float)nCached : 0;
+            }
+                break;
+            case NdnRtcOut::InfoChopIndex::CacheBytes:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().cacheBytes_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::LayersNum:
+                chan->value = pimpl_ ? (float)(1 + subLayers_.size()) : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::TargetBitrate:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().targetBitrate_ : 0;
+                break;
+            case NdnRtcOut::InfoChopIndex::TargetGop:
+                chan->value = pimpl_ ? (float)pimpl_->getCounters().targetGop_ : 0;
+                break;
             default:
             {
                 chan->value = 0;
@@ -548,30 +1621,16 @@ NdnRtcOut::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1
     }
     else
     {
-        if (pimpl_ && pimpl_->getIsInitialized())
+        int nStats = (int)statsSnapshot_.size();
+        int statIdx = (int)index - (int)ChanNames.size();
+        
+        if (statIdx < nStats)
         {
-            statistics::StatisticsStorage ss = pimpl_->getStats();
-            int nStats = (int)ss.getIndicators().size();
-            if (index - ChanNames.size() < nStats)
-            {
-                int statIdx = ((int)index - (int)ChanNames.size());
-                int idx = 0;
-                for (auto pair:ss.getIndicators())
-                {
-                    if (idx == statIdx)
-                    {
-                        chan->name->setString(statistics::StatisticsStorage::IndicatorKeywords.at(pair.first).c_str());
-                        chan->value = (float)pair.second;
-                        break;
-                    }
-                    idx++;
-                }
-            }
-            else
-                BaseTOP::getInfoCHOPChan(index - (int32_t)ChanNames.size() - nStats, chan, reserved1);
+            chan->name->setString(statsSnapshot_[statIdx].first);
+            chan->value = (float)statsSnapshot_[statIdx].second;
         }
         else
-            BaseTOP::getInfoCHOPChan(index - (int32_t)ChanNames.size(), chan, reserved1);
+            BaseTOP::getInfoCHOPChan(statIdx - nStats, chan, reserved1);
     }
 }
 
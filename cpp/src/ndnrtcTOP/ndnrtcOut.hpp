@@ -35,7 +35,20 @@ namespace touch_ndn {
     class NdnRtcOut : public BaseTOP {
     public:
         enum class InfoChopIndex : int32_t {
-            FrameNumber
+            FrameNumber,
+            FramesPublished,
+            PacketsPublished,
+            BytesPublished,
+            PacketsCached,
+            EncodeTimeUs,
+            PendingInterests,
+            PendingSatisfied,
+            CacheHitRate,
+            CacheEvictionRate,
+            CacheBytes,
+            LayersNum,
+            TargetBitrate,
+            TargetGop
         };
         enum class InfoDatIndex : int32_t {
             LibVersion,
@@ -75,11 +88,17 @@ namespace touch_ndn {
     private:
         class Impl;
         std::shared_ptr<Impl> pimpl_;
+        // simulcast layers below full resolution, in decreasing resolution
+        std::vector<std::shared_ptr<Impl>> subLayers_;
+        int layersWidth_, layersHeight_;
         int bufferWidth_, bufferHeight_;
         std::vector<uint8_t> buffer_;
+        // flat copy of stream statistics, taken once per cook in getNumInfoCHOPChans()
+        std::vector<std::pair<const char*, double>> statsSnapshot_;
         
-        bool useFec_, dropFrames_, isCacheEnabled_;
-        int32_t targetBitrate_, segmentSize_, gopSize_, cacheLength_;
+        bool useFec_, dropFrames_, isCacheEnabled_, isAbrEnabled_, isAbrRecreateEnabled_;
+        int32_t targetBitrate_, segmentSize_, gopSize_, cacheLength_, cacheSize_, nLayers_;
+        int32_t abrMinBitrate_;
         std::string faceDat_, keyChainDat_;
         
         FaceDAT *getFaceDatOp() { return (FaceDAT*)getPairedOp(faceDat_); }
@@ -87,6 +106,14 @@ namespace touch_ndn {
         
         void initStream();
         void releaseStream();
+        void initLayers(int width, int height);
+        void publishLayers(int width, int height);
+        void releaseLayers();
+        void applyAbr();
+        int32_t getLayerAbrMinBitrate(int layerIdx) const;
+        std::string getLayersBase() const;
+        std::string getLayerName(int layerIdx) const;
+        size_t getCacheSizeBytes() const { return (size_t)cacheSize_*1024*1024; }
         
         void onOpUpdate(OP_Common*, const std::string& event) override;
         void opPathUpdated(const std::string& oldFullPath,
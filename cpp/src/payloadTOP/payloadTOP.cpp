@@ -102,6 +102,10 @@ PayloadTOP::PayloadTOP(const OP_NodeInfo *info)
 , bufferWidth_(0)
 , bufferHeight_(0)
 , lastBufferUpdate_(0)
+, bufferHash_(0)
+, bufferVersion_(0)
+, outputVersion_(0)
+, bufferMemory_(trackMemory("buffer"))
 {
     OPLOG_DEBUG("Created PayloadTOP");
 }
@@ -154,15 +158,28 @@ PayloadTOP::execute(TOP_OutputFormatSpecs* outputFormat,
             OP_TOPInputDownloadOptions options;
             void *frameData = inputs->getTOPDataInCPUMemory(input, &options);
             if (frameData)
-                memcpy(buffer_->data(), frameData, bufferSize_);
-
+            {
+                // static input is neither copied nor picked up by NamespaceDAT for publishing
+                uint64_t hash = contentHash(frameData, bufferSize_);
+                if (hash != bufferHash_)
+                {
+                    memcpy(buffer_->data(), frameData, bufferSize_);
+                    bufferHash_ = hash;
+                    bufferVersion_++;
+                }
+            }
         }
     }
     
     uint8_t* mem = (uint8_t*)outputFormat->cpuPixelData[0];
 
-    if (mem && buffer_)
+    if (mem && buffer_ && outputVersion_ != bufferVersion_)
+    {
         memcpy(mem, buffer_->data(), bufferSize_);
-
-    outputFormat->newCPUPixelDataLocation = 0;
+        outputVersion_ = bufferVersion_;
+        outputFormat->newCPUPixelDataLocation = 0;
+    }
+    else
+        // keep previously uploaded texture
+        outputFormat->newCPUPixelDataLocation = -1;
 }
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include "baseTOP.hpp"
+#include "content-hash.hpp"
 
 namespace touch_ndn {
     class PayloadTOP : public BaseTOP {
@@ -51,17 +52,27 @@ namespace touch_ndn {
             return buffer_;
         }
         
+        // incremented every time buffer content changes
+        uint64_t getBufferVersion() const { return bufferVersion_; }
+        
         void setBuffer(const std::vector<uint8_t> &buffer, int width, int height)
         {
+            uint64_t hash = contentHash(buffer.data(), buffer.size());
+            if (width == bufferWidth_ && height == bufferHeight_ && hash == bufferHash_)
+                return;
+            
             allocateBuffer(width, height);
             assert(bufferSize_ == buffer.size());
             memcpy(buffer_->data(), buffer.data(), bufferSize_);
+            bufferHash_ = hash;
         }
 
     private:
         int bufferSize_, bufferWidth_, bufferHeight_;
         uint64_t lastBufferUpdate_;
+        uint64_t bufferHash_, bufferVersion_, outputVersion_;
         std::shared_ptr<std::vector<uint8_t>> buffer_;
+        TrackedMemory bufferMemory_;
         
         void allocateBuffer(int w, int h)
         {
@@ -69,6 +80,9 @@ namespace touch_ndn {
             bufferHeight_ = h;
             bufferSize_ = w*h*4*sizeof(uint8_t);
             buffer_ = std::make_shared<std::vector<uint8_t>>(bufferSize_);
+            bufferMemory_.set(bufferSize_);
+            bufferHash_ = 0;
+            bufferVersion_++;
         }
     };
 }
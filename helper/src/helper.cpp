@@ -20,6 +20,23 @@
 
 #include "helper.hpp"
 
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
 #include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -40,18 +57,76 @@ using namespace touch_ndn;
 #define TLOG_LEVEL_ENV "TOUCHNDN_LOG_LEVEL"
 #define TLOG_FORMAT_ENV "TOUCHNDN_LOG_FMT"
 #define TLOG_FILE_ENV "TOUCHNDN_LOG_FILE"
+// logging mode
+// could be either:
+// - "spdlog" (default) -- messages are formatted by the calling thread
+// - "ring" -- operators' messages are stored as binary records in a per-thread
+//             lock-free ring and formatted by a background thread
+#define TLOG_MODE_ENV "TOUCHNDN_LOG_MODE"
+// number of records in per-thread ring (rounded up to power of two)
+#define TLOG_RING_SIZE_ENV "TOUCHNDN_LOG_RING_SIZE"
+
+#define TLOG_RING_SIZE_DEFAULT 1024
+#define TLOG_RING_THREAD_NAME "touchndn-log"
+#define TLOG_ASYNC_THREAD_NAME "touchndn-spdlog"
+#define TLOG_RING_IDLE_SLEEP_MS 2
 
 namespace touch_ndn {
     void initLibrary();
     void initLogger(shared_ptr<spdlog::logger>);
+    void startRingLog();
+    void stopRingLog();
+    void onAsyncLogThreadStart();
+}
+
+namespace {
+    // single-producer single-consumer ring of log records
+    // producer is the thread that owns the ring, consumer is the log thread
+    struct LogRing {
+        LogRing(size_t capacity)
+        : records_(capacity), mask_(capacity-1)
+        , head_(0), tail_(0), dropped_(0), orphaned_(false) {}
+
+        vector<helpers::LogRecord> records_;
+        const size_t mask_;
+        atomic<size_t> head_, tail_;
+        atomic<uint64_t> dropped_;
+        atomic<bool> orphaned_;
+    };
+
+    // registers calling thread's ring on first use; marks it orphaned when
+    // thread exits so the log thread can drain and release it
+    struct LogRingHandle {
+        shared_ptr<LogRing> ring_;
+        ~LogRingHandle() { if (ring_) ring_->orphaned_ = true; }
+    };
+
+    thread_local LogRingHandle threadRing;
 }
 
 map<string, void*> TouchNdnOps;
+mutex memoryCountersMtx;
+map<void*, map<string, shared_ptr<MemoryCounter>>> memoryCounters;
 shared_ptr<spdlog::logger> mainLogger;
 string logFile = "";
 string logLevel = "";
 once_flag onceFlag;
 
+bool ringLogEnabled = false;
+size_t ringSize = TLOG_RING_SIZE_DEFAULT;
+mutex ringsMutex;
+vector<shared_ptr<LogRing>> logRings;
+atomic<uint64_t> ringDropped(0);
+atomic<bool> ringLogRunning(false);
+thread ringLogThread;
+mutex logThreadOptionsMtx;
+helpers::ThreadOptions logThreadOptions;
+atomic<bool> logThreadOptionsPending(false);
+// spdlog's async thread (log file mode), set once it starts
+atomic<bool> asyncLogThreadStarted(false);
+pthread_t asyncLogThread;
+long asyncLogThreadTid = 0;
+
 struct _LibInitializer {
     _LibInitializer() {
         call_once(onceFlag, bind(initLibrary));
@@ -64,6 +139,11 @@ __attribute__((constructor)) void helper_ctor(){
 __attribute__((destructor)) void helper_dtor(){
 }
 
+// declared after all globals the log thread uses, so it is destroyed first
+struct _RingLogStopper {
+    ~_RingLogStopper() { stopRingLog(); }
+} ringLogStopper = {};
+
 namespace touch_ndn
 {
 
@@ -97,6 +177,11 @@ bool updateOp(string path, void* caller, string newPath)
 
 bool eraseOp(string path, void* caller)
 {
+    {
+        lock_guard<mutex> lock(memoryCountersMtx);
+        memoryCounters.erase(caller);
+    }
+
     void *op = retrieveOp(path);
     if (op && op == caller)
     {
@@ -115,13 +200,75 @@ vector<string> getOpList()
     return opList;
 }
 
+shared_ptr<MemoryCounter> getMemoryCounter(void* op, const string& category)
+{
+    lock_guard<mutex> lock(memoryCountersMtx);
+    shared_ptr<MemoryCounter>& counter = memoryCounters[op][category];
+    if (!counter)
+        counter = make_shared<MemoryCounter>(0);
+    return counter;
+}
+
+map<string, map<string, int64_t>> getMemoryUsage()
+{
+    map<string, map<string, int64_t>> usage;
+    lock_guard<mutex> lock(memoryCountersMtx);
+
+    for (auto &op:TouchNdnOps)
+    {
+        auto it = memoryCounters.find(op.second);
+        if (it == memoryCounters.end())
+            continue;
+
+        map<string, int64_t> &opUsage = usage[op.first];
+        for (auto &c:it->second)
+            opUsage[c.first] = c.second->load();
+    }
+    return usage;
+}
+
+void dumpMemoryUsage()
+{
+    int64_t total = 0;
+    map<string, map<string, int64_t>> usage = getMemoryUsage();
+
+    TLOG_INFO("Memory usage by {} op(s):", usage.size());
+    for (auto &op:usage)
+    {
+        int64_t opTotal = 0;
+        stringstream ss;
+        for (auto &c:op.second)
+        {
+            ss << " " << c.first << "=" << c.second;
+            opTotal += c.second;
+        }
+        total += opTotal;
+        TLOG_INFO("  {} total={}{}", op.first, opTotal, ss.str());
+    }
+    TLOG_INFO("Memory usage total: {} bytes", total);
+    spdlog::default_logger()->flush();
+}
+
 void initLibrary()
 {
     logLevel = getenv(TLOG_LEVEL_ENV) ? string(getenv(TLOG_LEVEL_ENV)) : "";
     logFile = getenv(TLOG_FILE_ENV) ? string(getenv(TLOG_FILE_ENV)) : "";
+    ringLogEnabled = getenv(TLOG_MODE_ENV) ? string(getenv(TLOG_MODE_ENV)) == "ring" : false;
+    if (getenv(TLOG_RING_SIZE_ENV))
+    {
+        size_t requested = strtoul(getenv(TLOG_RING_SIZE_ENV), nullptr, 10);
+        ringSize = 1;
+        while (ringSize < requested) ringSize <<= 1;
+        if (ringSize < 16) ringSize = 16;
+    }
 
     if (logFile != "")
+    {
+        // async loggers share spdlog's thread pool -- set it up before any of them, so
+        // that its thread gets log thread options and can be sampled for CPU usage
+        spdlog::init_thread_pool(spdlog::details::default_async_q_size, 1, onAsyncLogThreadStart);
         mainLogger = spdlog::basic_logger_mt<spdlog::async_factory>("main", logFile);
+    }
     else
         mainLogger = spdlog::stdout_color_mt("main");
 
@@ -131,7 +278,11 @@ void initLibrary()
     spdlog::flush_every(std::chrono::seconds(3));
     spdlog::set_default_logger(mainLogger);
 
-    TLOG_INFO("Initialized TouchNDN logging: level {0} file {1}", logLevel, logFile);
+    if (ringLogEnabled)
+        startRingLog();
+
+    TLOG_INFO("Initialized TouchNDN logging: level {0} file {1} mode {2}", logLevel, logFile,
+              ringLogEnabled ? "ring" : "spdlog");
     spdlog::default_logger()->flush();
 }
 
@@ -170,4 +321,422 @@ void flushLogger(std::string loggerName)
     spdlog::get(loggerName)->flush();
 }
 
+
+bool isRingLogEnabled()
+{
+    return ringLogEnabled;
+}
+
+uint64_t getRingLogDropped()
+{
+    return ringDropped;
+}
+
+namespace helpers {
+
+LogRecord* acquireLogRecord()
+{
+    if (!threadRing.ring_)
+    {
+        threadRing.ring_ = make_shared<LogRing>(ringSize);
+        lock_guard<mutex> lock(ringsMutex);
+        logRings.push_back(threadRing.ring_);
+    }
+
+    LogRing &ring = *threadRing.ring_;
+    size_t head = ring.head_.load(memory_order_relaxed);
+    if (head - ring.tail_.load(memory_order_acquire) > ring.mask_)
+    {
+        ring.dropped_.fetch_add(1, memory_order_relaxed);
+        return nullptr;
+    }
+    return &ring.records_[head & ring.mask_];
+}
+
+void commitLogRecord(LogRecord*)
+{
+    LogRing &ring = *threadRing.ring_;
+    ring.head_.store(ring.head_.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+}
+
+namespace {
+
+struct ArgView {
+    helpers::LogRecord::ArgType type_;
+    const uint8_t *data_;
+    uint16_t len_;
+};
+
+void appendArg(string &out, const ArgView &a, const string &spec)
+{
+    int64_t i; uint64_t u; double d;
+
+    switch (a.type_) {
+        case helpers::LogRecord::Int:
+            memcpy(&i, a.data_, sizeof(i));
+            out += spec.empty() ? to_string(i) : fmt::format("{:" + spec + "}", i);
+            break;
+        case helpers::LogRecord::UInt:
+            memcpy(&u, a.data_, sizeof(u));
+            out += spec.empty() ? to_string(u) : fmt::format("{:" + spec + "}", u);
+            break;
+        case helpers::LogRecord::Double:
+            memcpy(&d, a.data_, sizeof(d));
+            out += fmt::format(spec.empty() ? "{}" : "{:" + spec + "}", d);
+            break;
+        case helpers::LogRecord::Bool:
+            out += (*a.data_ ? "true" : "false");
+            break;
+        case helpers::LogRecord::Char:
+            if (spec.empty())
+                out += (char)*a.data_;
+            else
+                out += fmt::format("{:" + spec + "}", (char)*a.data_);
+            break;
+        case helpers::LogRecord::Str:
+            if (spec.empty())
+                out.append((const char*)a.data_, a.len_);
+            else
+                out += fmt::format("{:" + spec + "}", string((const char*)a.data_, a.len_));
+            break;
+    }
+}
+
+// supports "{}", "{N}", "{:spec}", "{N:spec}" and "{{", "}}" escapes
+string formatRecord(const helpers::LogRecord &r)
+{
+    ArgView args[helpers::LogRecord::ArenaSize/2];
+    size_t nArgs = 0;
+
+    for (size_t pos = 0; pos < r.argsLen_ && nArgs < r.nArgs_; ++nArgs)
+    {
+        ArgView &a = args[nArgs];
+        a.type_ = (helpers::LogRecord::ArgType)r.args_[pos++];
+        switch (a.type_) {
+            case helpers::LogRecord::Bool: // fallthrough
+            case helpers::LogRecord::Char: a.len_ = 1; break;
+            case helpers::LogRecord::Str:
+                memcpy(&a.len_, r.args_ + pos, sizeof(a.len_));
+                pos += sizeof(a.len_);
+                break;
+            default: a.len_ = 8; break;
+        }
+        a.data_ = r.args_ + pos;
+        pos += a.len_;
+    }
+
+    string out;
+    out.reserve(r.prefixLen_ + 128);
+    if (r.prefixLen_)
+    {
+        out += "[";
+        out.append(r.prefix_, r.prefixLen_);
+        out += "] ";
+    }
+
+    size_t autoIdx = 0;
+    for (const char *c = r.fmt_; *c; ++c)
+    {
+        if (*c == '{' && c[1] == '{') { out += '{'; ++c; continue; }
+        if (*c == '}' && c[1] == '}') { out += '}'; ++c; continue; }
+        if (*c != '{') { out += *c; continue; }
+
+        const char *end = strchr(c, '}');
+        if (!end) { out += c; break; }
+
+        string field(c+1, end-c-1), spec;
+        size_t colon = field.find(':');
+        if (colon != string::npos)
+        {
+            spec = field.substr(colon+1);
+            field = field.substr(0, colon);
+        }
+
+        size_t idx = field.empty() ? autoIdx++ : strtoul(field.c_str(), nullptr, 10);
+        if (idx < nArgs)
+            appendArg(out, args[idx], spec);
+        else
+            out += "{?}";
+        c = end;
+    }
+
+    return out;
+}
+
+// message goes to logger's sinks directly -- logging through the logger would stamp it
+// with the log thread's id
+void deliverRecord(const helpers::LogRecord &r)
+{
+    string msg = formatRecord(r);
+    spdlog::source_loc loc(r.file_, r.line_, r.func_);
+    spdlog::details::log_msg logMsg(loc, r.logger_->name(), r.level_, spdlog::string_view_t(msg));
+    logMsg.time = r.ts_;
+    logMsg.thread_id = r.threadId_;
+
+    for (auto &sink:r.logger_->sinks())
+        if (sink->should_log(logMsg.level))
+            sink->log(logMsg);
+
+    if (logMsg.level != spdlog::level::off && logMsg.level >= r.logger_->flush_level())
+        for (auto &sink:r.logger_->sinks())
+            sink->flush();
+}
+
+// drains all rings, returns number of delivered records
+size_t drainRings()
+{
+    vector<shared_ptr<LogRing>> rings;
+    {
+        lock_guard<mutex> lock(ringsMutex);
+        rings = logRings;
+    }
+
+    size_t delivered = 0;
+    uint64_t dropped = 0;
+
+    for (auto &ring:rings)
+    {
+        bool orphaned = ring->orphaned_;
+        size_t tail = ring->tail_.load(memory_order_relaxed);
+        size_t head = ring->head_.load(memory_order_acquire);
+
+        for (; tail != head; ++tail, ++delivered)
+        {
+            const helpers::LogRecord &r = ring->records_[tail & ring->mask_];
+            try {
+                if (r.logger_)
+                    deliverRecord(r);
+            }
+            catch (std::exception &e) {
+                fprintf(stderr, "touchndn-helper: failed to format log record: %s\n", e.what());
+            }
+            ring->tail_.store(tail+1, memory_order_release);
+        }
+
+        dropped += ring->dropped_.exchange(0, memory_order_relaxed);
+
+        if (orphaned)
+        {
+            lock_guard<mutex> lock(ringsMutex);
+            logRings.erase(remove(logRings.begin(), logRings.end(), ring), logRings.end());
+        }
+    }
+
+    if (dropped)
+    {
+        ringDropped += dropped;
+        if (mainLogger)
+            mainLogger->warn("log ring overflow: {} records dropped ({} total)", dropped,
+                             ringDropped.load());
+    }
+
+    return delivered;
+}
+
+}
+
+void startRingLog()
+{
+    if (ringLogRunning.exchange(true))
+        return;
+
+    ringLogThread = thread([](){
+        helpers::ThreadOptions defaultOptions;
+        defaultOptions.name_ = TLOG_RING_THREAD_NAME;
+        helpers::applyThreadOptions(defaultOptions);
+
+        while (ringLogRunning)
+        {
+            if (logThreadOptionsPending.exchange(false))
+            {
+                lock_guard<mutex> scopedLock(logThreadOptionsMtx);
+                helpers::applyThreadOptions(logThreadOptions);
+            }
+
+            if (!drainRings())
+                this_thread::sleep_for(chrono::milliseconds(TLOG_RING_IDLE_SLEEP_MS));
+        }
+        drainRings();
+    });
+}
+
+void onAsyncLogThreadStart()
+{
+    asyncLogThread = pthread_self();
+#if defined(__linux__)
+    asyncLogThreadTid = (long)syscall(SYS_gettid);
+#endif
+    asyncLogThreadStarted = true;
+
+    lock_guard<mutex> scopedLock(logThreadOptionsMtx);
+    helpers::ThreadOptions options(logThreadOptions);
+    options.name_ = TLOG_ASYNC_THREAD_NAME;
+    helpers::applyThreadOptions(options);
+}
+
+void stopRingLog()
+{
+    if (!ringLogRunning.exchange(false))
+        return;
+
+    if (ringLogThread.joinable())
+        ringLogThread.join();
+}
+
+}
+
+//******************************************************************************
+namespace touch_ndn {
+namespace helpers {
+
+namespace {
+
+// tid is used for nice value on Linux
+bool applyThreadOptions(pthread_t self, long tid, const ThreadOptions& options)
+{
+    bool ok = true;
+
+    if (options.name_.size())
+    {
+        string name = options.name_.substr(0, 15);
+#if defined(__APPLE__)
+        // macOS can only name the calling thread
+        if (pthread_equal(self, pthread_self()))
+            ok &= (pthread_setname_np(name.c_str()) == 0);
+#elif defined(__linux__)
+        ok &= (pthread_setname_np(self, name.c_str()) == 0);
+#endif
+    }
+
+    if (options.cpus_.size())
+    {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (auto c:options.cpus_)
+            if (c >= 0 && c < CPU_SETSIZE)
+                CPU_SET(c, &cpus);
+        ok &= (pthread_setaffinity_np(self, sizeof(cpus), &cpus) == 0);
+#elif defined(__APPLE__)
+        thread_affinity_policy_data_t policy = { options.cpus_[0] + 1 };
+        ok &= (thread_policy_set(pthread_mach_thread_np(self), THREAD_AFFINITY_POLICY,
+                                 (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS);
+#else
+        ok = false;
+#endif
+    }
+
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(self, &policy, &param) != 0)
+        return false;
+
+    if (options.realtimePriority_ > 0)
+    {
+        param.sched_priority = max(sched_get_priority_min(SCHED_FIFO),
+                                   min(options.realtimePriority_, sched_get_priority_max(SCHED_FIFO)));
+        ok &= (pthread_setschedparam(self, SCHED_FIFO, &param) == 0);
+    }
+    else
+    {
+        // options may be re-applied with realtime priority turned off
+        if (policy == SCHED_FIFO)
+        {
+            param.sched_priority = (sched_get_priority_min(SCHED_OTHER) + sched_get_priority_max(SCHED_OTHER)) / 2;
+            ok &= (pthread_setschedparam(self, SCHED_OTHER, &param) == 0);
+        }
+#if defined(__linux__)
+        ok &= (setpriority(PRIO_PROCESS, (id_t)tid, options.nice_) == 0);
+#else
+        ok &= (options.nice_ == 0);
+#endif
+    }
+
+    return ok;
+}
+
+}
+
+bool applyThreadOptions(const ThreadOptions& options)
+{
+#if defined(__linux__)
+    long tid = (long)syscall(SYS_gettid);
+#else
+    long tid = 0;
+#endif
+    return applyThreadOptions(pthread_self(), tid, options);
+}
+
+vector<int> parseCpuList(const string& cpuList)
+{
+    vector<int> cpus;
+    stringstream ss(cpuList);
+    string item;
+
+    while (getline(ss, item, ','))
+    {
+        int first, last;
+        char dash;
+        stringstream is(item);
+
+        if (!(is >> first))
+            continue;
+        if (is >> dash && dash == '-' && is >> last)
+            for (int c = first; c <= last; ++c)
+                cpus.push_back(c);
+        else
+            cpus.push_back(first);
+    }
+
+    return cpus;
+}
+
+uint64_t getThreadCpuTimeUs(thread::native_handle_type thread)
+{
+#if defined(__linux__)
+    clockid_t clockId;
+    timespec ts;
+    if (pthread_getcpuclockid(thread, &clockId) == 0 && clock_gettime(clockId, &ts) == 0)
+        return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#elif defined(__APPLE__)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(pthread_mach_thread_np(thread), THREAD_BASIC_INFO,
+                    (thread_info_t)&info, &count) == KERN_SUCCESS)
+        return (uint64_t)(info.user_time.seconds + info.system_time.seconds)*1000000 +
+            info.user_time.microseconds + info.system_time.microseconds;
+#endif
+    return 0;
+}
+
+void setLogThreadOptions(const ThreadOptions& options)
+{
+    lock_guard<mutex> scopedLock(logThreadOptionsMtx);
+    logThreadOptions = options;
+    if (logThreadOptions.name_.empty())
+        logThreadOptions.name_ = TLOG_RING_THREAD_NAME;
+    logThreadOptionsPending = true;
+
+    // spdlog's thread runs its own loop, options are applied to it from here
+    if (asyncLogThreadStarted)
+    {
+        ThreadOptions asyncOptions(options);
+        asyncOptions.name_ = TLOG_ASYNC_THREAD_NAME;
+        applyThreadOptions(asyncLogThread, asyncLogThreadTid, asyncOptions);
+    }
+}
+
+uint64_t getLogThreadCpuTimeUs()
+{
+    uint64_t cpuTimeUs = 0;
+    if (ringLogRunning && ringLogThread.joinable())
+        cpuTimeUs += getThreadCpuTimeUs(ringLogThread.native_handle());
+    if (asyncLogThreadStarted)
+        cpuTimeUs += getThreadCpuTimeUs(asyncLogThread);
+    return cpuTimeUs;
+}
+
+}
 }
@@ -22,17 +22,25 @@
 #define touchNDN_shared_hpp
 
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
+#include <thread>
+#include <type_traits>
 
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
 #include <spdlog/spdlog.h>
+#include <spdlog/details/os.h>
 
 #define TLOG_TRACE SPDLOG_TRACE
 #define TLOG_DEBUG SPDLOG_DEBUG
 #define TLOG_INFO SPDLOG_INFO
-#define TLOG_WARN SPDLOG_WARNING
+#define TLOG_WARN SPDLOG_WARN
 #define TLOG_ERROR SPDLOG_ERROR
 
 #define TLOG_LOGGER_TRACE SPDLOG_LOGGER_TRACE
@@ -44,6 +52,14 @@
 
 #define TLOG_TRACE_TAG(tag, ...) (TLOG_TRACE(tag##__VA_ARGS__))
 
+// level tokens used by the TLOG_/OPLOG_ macro families
+#define TLOG_LEVEL_TRACE spdlog::level::trace
+#define TLOG_LEVEL_DEBUG spdlog::level::debug
+#define TLOG_LEVEL_INFO spdlog::level::info
+#define TLOG_LEVEL_WARN spdlog::level::warn
+#define TLOG_LEVEL_ERROR spdlog::level::err
+#define TLOG_LEVEL_CRITICAL spdlog::level::critical
+
 #include "config.hpp"
 
 namespace touch_ndn {
@@ -51,6 +67,154 @@ namespace touch_ndn {
     namespace helpers {
         typedef spdlog::logger logger;
         typedef spdlog::level::level_enum log_level;
+
+        /**
+         * Fixed-size binary log record. Records are filled in-place by the
+         * logging thread (no formatting, no allocations) and formatted later
+         * by the log thread. Arguments are stored tagged in a small arena;
+         * strings are copied (and truncated, if they don't fit). Calling thread's id is
+         * kept, so that formatted messages show where they were logged from.
+         */
+        struct LogRecord {
+            enum ArgType : uint8_t { Int, UInt, Double, Bool, Str, Char };
+            static const size_t MaxPrefix = 96;
+            static const size_t ArenaSize = 344;
+
+            spdlog::log_clock::time_point ts_;
+            size_t threadId_;
+            logger *logger_;
+            const char *fmt_, *file_, *func_;
+            int line_;
+            log_level level_;
+            uint8_t nArgs_, prefixLen_;
+            uint16_t argsLen_;
+            char prefix_[MaxPrefix];
+            uint8_t args_[ArenaSize];
+
+            void init(logger *l, log_level lvl, const char *file, int line, const char *func,
+                      const char *prefix, size_t prefixLen, const char *fmt)
+            {
+                ts_ = spdlog::log_clock::now();
+                threadId_ = spdlog::details::os::thread_id();
+                logger_ = l; level_ = lvl;
+                file_ = file; line_ = line; func_ = func;
+                fmt_ = fmt;
+                nArgs_ = 0; argsLen_ = 0;
+                // keep the tail of long paths -- it is the most specific part
+                if (prefixLen > MaxPrefix)
+                {
+                    prefix += prefixLen - MaxPrefix;
+                    prefixLen = MaxPrefix;
+                }
+                prefixLen_ = (uint8_t)prefixLen;
+                if (prefixLen)
+                    memcpy(prefix_, prefix, prefixLen);
+            }
+
+            void pack() {}
+            template<typename T, typename... Args>
+            void pack(const T& v, const Args&... args) { add(v); pack(args...); }
+
+            void add(bool v) { uint8_t b = v; put(Bool, &b, 1); }
+            void add(char v) { put(Char, &v, 1); }
+            void add(double v) { put(Double, &v, sizeof(v)); }
+            void add(float v) { add((double)v); }
+            void add(const char *v) { addStr(v ? v : "(null)", v ? strlen(v) : 6); }
+            void add(const std::string &v) { addStr(v.data(), v.size()); }
+            template<typename T>
+            typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+            add(T v) { int64_t i = v; put(Int, &i, sizeof(i)); }
+            template<typename T>
+            typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                    !std::is_same<T, bool>::value>::type
+            add(T v) { uint64_t u = v; put(UInt, &u, sizeof(u)); }
+            // anything else is formatted right away
+            template<typename T>
+            typename std::enable_if<!std::is_arithmetic<T>::value>::type
+            add(const T& v) { add(fmt::format("{}", v)); }
+
+        private:
+            void put(ArgType t, const void *v, size_t len)
+            {
+                if (argsLen_ + 1 + len > ArenaSize)
+                    return;
+                args_[argsLen_++] = t;
+                memcpy(args_ + argsLen_, v, len);
+                argsLen_ += len;
+                nArgs_++;
+            }
+            void addStr(const char *s, size_t len)
+            {
+                size_t room = ArenaSize - argsLen_;
+                if (room < 1 + sizeof(uint16_t))
+                    return;
+                len = std::min(len, room - 1 - sizeof(uint16_t));
+                uint16_t l = (uint16_t)len;
+                args_[argsLen_++] = Str;
+                memcpy(args_ + argsLen_, &l, sizeof(l));
+                argsLen_ += sizeof(l);
+                memcpy(args_ + argsLen_, s, len);
+                argsLen_ += len;
+                nArgs_++;
+            }
+        };
+
+        /**
+         * Scheduling options for background threads (Face processing, logging, workers).
+         */
+        struct ThreadOptions {
+            ThreadOptions(): realtimePriority_(0), nice_(0) {}
+
+            // thread name, truncated to 15 characters (platform limit)
+            std::string name_;
+            // CPU cores thread may run on, empty -- no restriction; on macOS threads can't be
+            // pinned, so first core is used as an affinity tag (threads with the same tag are
+            // scheduled to share L2 cache)
+            std::vector<int> cpus_;
+            // if non-zero, thread is scheduled with SCHED_FIFO at this priority (1-99);
+            // usually requires elevated privileges
+            int realtimePriority_;
+            // nice value for non-realtime threads (Linux only)
+            int nice_;
+        };
+
+        // applies options to the calling thread; returns false if any of them couldn't be
+        // applied (the rest are applied anyway)
+        bool applyThreadOptions(const ThreadOptions& options);
+        // parses comma-separated list of cores and ranges, i.e. "2,3" or "4-7"
+        std::vector<int> parseCpuList(const std::string& cpuList);
+        // returns CPU time consumed by the thread so far, in microseconds (0 if unsupported)
+        uint64_t getThreadCpuTimeUs(std::thread::native_handle_type thread);
+
+        // options for the log threads -- ring log thread (applied by the thread itself shortly
+        // after the call) and spdlog's async thread used in log file mode
+        void setLogThreadOptions(const ThreadOptions& options);
+        // returns CPU time consumed by the log threads (0 if none are running)
+        uint64_t getLogThreadCpuTimeUs();
+
+        // returns next free record in the calling thread's ring or nullptr if the
+        // ring is full (record is dropped and counted)
+        LogRecord* acquireLogRecord();
+        // publishes record, previously returned by acquireLogRecord()
+        void commitLogRecord(LogRecord*);
+    }
+
+    // true if TOUCHNDN_LOG_MODE is "ring"
+    bool isRingLogEnabled();
+    // number of records dropped because of ring overflow
+    uint64_t getRingLogDropped();
+
+    template<typename... Args>
+    inline void ringLog(helpers::logger *l, helpers::log_level lvl,
+                        const char *file, int line, const char *func,
+                        const char *prefix, size_t prefixLen,
+                        const char *fmt, const Args&... args)
+    {
+        helpers::LogRecord *r = helpers::acquireLogRecord();
+        if (!r) return;
+        r->init(l, lvl, file, line, func, prefix, prefixLen, fmt);
+        r->pack(args...);
+        helpers::commitLogRecord(r);
     }
 
     bool saveOp(std::string path, void* op);
@@ -59,6 +223,43 @@ namespace touch_ndn {
     bool eraseOp(std::string path, void* caller);
     std::vector<std::string> getOpList();
 
+    // Per-op memory accounting. Ops attribute bytes they hold to named categories
+    // (i.e. "buffer", "requests"); counters can be updated from any thread.
+    typedef std::atomic<int64_t> MemoryCounter;
+
+    // returns op's counter for the category, creating it if needed; counters are
+    // dropped from the registry once op is erased with eraseOp()
+    std::shared_ptr<MemoryCounter> getMemoryCounter(void* op, const std::string& category);
+    // returns bytes held by registered ops, per category, keyed by op path
+    std::map<std::string, std::map<std::string, int64_t>> getMemoryUsage();
+    // logs getMemoryUsage() along with per-op and overall totals
+    void dumpMemoryUsage();
+
+    /**
+     * Accounts for a block of memory in a counter for as long as the object lives.
+     */
+    class TrackedMemory {
+    public:
+        TrackedMemory(std::shared_ptr<MemoryCounter> counter = nullptr, int64_t bytes = 0)
+        : counter_(counter), bytes_(0) { set(bytes); }
+        ~TrackedMemory() { set(0); }
+
+        TrackedMemory(const TrackedMemory&) = delete;
+        TrackedMemory& operator=(const TrackedMemory&) = delete;
+
+        void set(int64_t bytes)
+        {
+            if (counter_) *counter_ += bytes - bytes_;
+            bytes_ = bytes;
+        }
+        void add(int64_t bytes) { set(bytes_ + bytes); }
+        int64_t get() const { return bytes_; }
+
+    private:
+        std::shared_ptr<MemoryCounter> counter_;
+        int64_t bytes_;
+    };
+
     void newLogger(std::string loggerName);
     std::shared_ptr<helpers::logger> getLogger(std::string loggerName);
     void flushLogger(std::string loggerName);